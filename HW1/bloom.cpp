@@ -0,0 +1,76 @@
+#include <algorithm>
+#include <functional>
+#include "bloom.h"
+using namespace std;
+
+// Constructor
+bloomFilter::bloomFilter(size_t keys, double bitsPerKey) {
+    size_t bits = keys * bitsPerKey;
+    blocks.resize(max<size_t>(1, (bits + 255) / 256));
+}
+
+// Insert function
+void bloomFilter::insert(string_view key) {
+    uint64_t h = hash(key);
+    uint32_t bits[8];
+    pattern(h, bits);
+    block &b = blocks[blockOf(h)];
+    for (int i = 0; i < 8; i++) {
+        b.words[i] |= bits[i];
+    }
+}
+
+// May contain function
+bool bloomFilter::mayContain(string_view key) const {
+    return matches(hash(key));
+}
+
+// May contain batch function
+void bloomFilter::mayContainBatch(const string_view *keys, size_t count, bool *maybe) const {
+    uint64_t hashes[batchGroup];
+    for (size_t i = 0; i < count; i += batchGroup) {
+        size_t n = min<size_t>(batchGroup, count - i);
+        for (size_t j = 0; j < n; j++) {
+            hashes[j] = hash(keys[i + j]);
+            __builtin_prefetch(&blocks[blockOf(hashes[j])]);
+        }
+        for (size_t j = 0; j < n; j++) {
+            maybe[i + j] = matches(hashes[j]);
+        }
+    }
+}
+
+// Hash function
+uint64_t bloomFilter::hash(string_view key) {
+    // std::hash makes no promise that both halves of its value are
+    // well spread, so mix them before they are used separately
+    uint64_t h = std::hash<string_view>()(key);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    return h;
+}
+
+// Pattern function
+void bloomFilter::pattern(uint64_t h, uint32_t *bits) {
+    static const uint32_t salts[8] = {
+        0x47b6137bu, 0x44974d91u, 0x8824ad5bu, 0xa2b7289du,
+        0x705495c7u, 0x2df1424bu, 0x9efc4947u, 0x5c6bfb31u
+    };
+    uint32_t x = static_cast<uint32_t>(h);
+    for (int i = 0; i < 8; i++) {
+        bits[i] = 1u << ((x * salts[i]) >> 27);
+    }
+}
+
+// Matches function
+bool bloomFilter::matches(uint64_t h) const {
+    uint32_t bits[8];
+    pattern(h, bits);
+    const block &b = blocks[blockOf(h)];
+    uint32_t missing = 0;
+    for (int i = 0; i < 8; i++) {
+        missing |= bits[i] & ~b.words[i];
+    }
+    return missing == 0;
+}
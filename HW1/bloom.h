@@ -0,0 +1,70 @@
+#ifndef _BLOOM_H
+#define _BLOOM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// A blocked Bloom filter: a compact set that answers "definitely
+// not present" or "maybe present" for a key.
+//
+// Each key hashes to one 32-byte block and sets one bit in each of
+// the block's eight 32-bit words, so a lookup reads a single cache
+// line whatever the answer. It is meant to sit in front of a hash
+// table and turn away unknown keys before their probe chain is
+// walked. With the default 10 bits per key about 1% of unknown keys
+// get through.
+class bloomFilter {
+
+ public:
+
+  // The constructor sizes the filter for the specified number of
+  // keys at the specified number of bits per key.
+  bloomFilter(std::size_t keys = 0, double bitsPerKey = 10);
+
+  // Add the specified key.
+  void insert(std::string_view key);
+
+  // Check the specified key. Returns false only if the key was
+  // never inserted.
+  bool mayContain(std::string_view key) const;
+
+  // Check count keys at once; maybe[i] is set as mayContain would
+  // for keys[i]. The blocks of a group are prefetched before any
+  // is read.
+  void mayContainBatch(const std::string_view *keys, std::size_t count, bool *maybe) const;
+
+  // Size of the filter in bytes.
+  std::size_t bytes() const { return blocks.size() * sizeof(block); }
+
+ private:
+
+  class alignas(32) block {
+  public:
+    std::uint32_t words[8] {};
+  };
+
+  std::vector<block> blocks;
+
+  // Number of lookups mayContainBatch hashes and prefetches together.
+  static const int batchGroup = 16;
+
+  // The hash function; the top half picks the block, the bottom
+  // half the bits within it.
+  static std::uint64_t hash(std::string_view key);
+
+  // The block for hash value h.
+  std::size_t blockOf(std::uint64_t h) const {
+    return ((h >> 32) * blocks.size()) >> 32;
+  }
+
+  // The bit pattern for hash value h: one bit per word, each
+  // picked by multiplying the low half of h by a different odd salt.
+  static void pattern(std::uint64_t h, std::uint32_t *bits);
+
+  // Check the pattern for hash value h against its block.
+  bool matches(std::uint64_t h) const;
+};
+
+#endif //_BLOOM_H
@@ -0,0 +1,327 @@
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <new>
+#include "concurrent.h"
+using namespace std;
+
+concurrentTable::hashItem concurrentTable::deletedItem;
+
+// Table constructor
+concurrentTable::table::table(int capacity)
+    : capacity(capacity), shift(getShift(capacity)),
+      slots(new atomic<hashItem *>[capacity]) {
+    for (int i = 0; i < capacity; i++) {
+        slots[i].store(nullptr, memory_order_relaxed);
+    }
+}
+
+// Constructor
+concurrentTable::concurrentTable(int size) {
+    shards.reset(new shard[shardCount]);
+    int capacity = getCapacity(size > 0 ? size / shardCount + 1 : 0);
+    for (int i = 0; i < shardCount; i++) {
+        shards[i].current.store(new table(capacity), memory_order_release);
+    }
+}
+
+// Destructor
+concurrentTable::~concurrentTable() {
+    for (int i = 0; i < shardCount; i++) {
+        delete shards[i].current.load(memory_order_relaxed);
+    }
+}
+
+// Insert function
+int concurrentTable::insert(string_view key, void *pv) {
+    size_t h = hash(key);
+    shard &s = shardOf(h);
+    lock_guard<mutex> guard(s.writeLock);
+
+    table *t = s.current.load(memory_order_relaxed);
+    if (probe(t, key, h) != nullptr) {
+        return 1;
+    }
+
+    // Same load limit as hashTable: tombstones count towards it,
+    // and a table that is mostly tombstones is rebuilt in place
+    if (s.filled + s.tombstones >= t->capacity / 2) {
+        int newCapacity = s.tombstones < s.filled ? t->capacity * 2 : t->capacity;
+        if (!rehash(s, newCapacity)) {
+            return 2;
+        }
+        t = s.current.load(memory_order_relaxed);
+    }
+
+    hashItem *item = newItem(s, key, h, pv);
+    if (item == nullptr) {
+        return 2;
+    }
+    s.liveBytes += itemSize(key.size());
+
+    // Take the first empty or deleted slot on the chain; the
+    // release store makes the item's fields visible to readers
+    // that see the pointer
+    int mask = t->capacity - 1;
+    int pos = slot(h, t->shift);
+    hashItem *current;
+    while ((current = t->slots[pos].load(memory_order_relaxed)) != nullptr
+           && current != &deletedItem) {
+        pos = (pos + 1) & mask;
+    }
+    if (current == &deletedItem) {
+        s.tombstones--;
+    }
+    t->slots[pos].store(item, memory_order_release);
+    s.filled++;
+    s.count.store(s.filled, memory_order_relaxed);
+    return 0;
+}
+
+// Contains function
+bool concurrentTable::contains(string_view key) const {
+    readGuard guard(readers);
+    return findItem(key, hash(key)) != nullptr;
+}
+
+// Get pointer function
+void *concurrentTable::getPointer(string_view key, bool *b) const {
+    readGuard guard(readers);
+    hashItem *item = findItem(key, hash(key));
+    if (b != nullptr) {
+        *b = (item != nullptr);
+    }
+    return item != nullptr ? item->pv.load(memory_order_acquire) : nullptr;
+}
+
+// Set pointer function
+int concurrentTable::setPointer(string_view key, void *pv) {
+    // Under the writer lock, so a rehash copying the item
+    // cannot miss the new pointer
+    size_t h = hash(key);
+    lock_guard<mutex> guard(shardOf(h).writeLock);
+    hashItem *item = findItem(key, h);
+    if (item == nullptr) {
+        return 1;
+    }
+    item->pv.store(pv, memory_order_release);
+    return 0;
+}
+
+// Remove function
+bool concurrentTable::remove(string_view key) {
+    size_t h = hash(key);
+    shard &s = shardOf(h);
+    lock_guard<mutex> guard(s.writeLock);
+
+    table *t = s.current.load(memory_order_relaxed);
+    int pos;
+    if (probe(t, key, h, &pos) == nullptr) {
+        return false;
+    }
+    // The item itself stays in its chunk, since a reader may still
+    // hold it, until a rehash copies the live items out
+    size_t bytes = itemSize(key.size());
+    t->slots[pos].store(&deletedItem, memory_order_release);
+    s.liveBytes -= bytes;
+    s.deadBytes += bytes;
+    s.filled--;
+    s.tombstones++;
+    s.count.store(s.filled, memory_order_relaxed);
+    return true;
+}
+
+// Contains batch function
+void concurrentTable::containsBatch(const string_view *keys, size_t count, bool *found) const {
+    readGuard guard(readers);
+    hashItem *items[batchGroup];
+    for (size_t i = 0; i < count; i += batchGroup) {
+        size_t n = min<size_t>(batchGroup, count - i);
+        findBatch(keys + i, n, items);
+        for (size_t j = 0; j < n; j++) {
+            found[i + j] = (items[j] != nullptr);
+        }
+    }
+}
+
+// Get pointer batch function
+void concurrentTable::getPointerBatch(const string_view *keys, size_t count, void **pointers) const {
+    readGuard guard(readers);
+    hashItem *items[batchGroup];
+    for (size_t i = 0; i < count; i += batchGroup) {
+        size_t n = min<size_t>(batchGroup, count - i);
+        findBatch(keys + i, n, items);
+        for (size_t j = 0; j < n; j++) {
+            pointers[i + j] = items[j] != nullptr ? items[j]->pv.load(memory_order_acquire) : nullptr;
+        }
+    }
+}
+
+// Size function
+size_t concurrentTable::size() const {
+    size_t total = 0;
+    for (int i = 0; i < shardCount; i++) {
+        total += shards[i].count.load(memory_order_relaxed);
+    }
+    return total;
+}
+
+// Find batch function
+void concurrentTable::findBatch(const string_view *keys, size_t count, hashItem **items) const {
+    size_t hashes[batchGroup];
+    for (size_t i = 0; i < count; i++) {
+        hashes[i] = hash(keys[i]);
+        const table *t = shardOf(hashes[i]).current.load();
+        __builtin_prefetch(&t->slots[slot(hashes[i], t->shift)]);
+    }
+    for (size_t i = 0; i < count; i++) {
+        items[i] = findItem(keys[i], hashes[i]);
+    }
+}
+
+// Hash function
+size_t concurrentTable::hash(string_view key) {
+    std::hash<string_view> hasher;
+    return hasher(key);
+}
+
+// Probe function
+concurrentTable::hashItem *concurrentTable::probe(const table *t, string_view key,
+                                                  size_t h, int *pos) {
+    int mask = t->capacity - 1;
+    int at = slot(h, t->shift);
+
+    // A table is never more than half full, so an empty slot ends
+    // every chain and the loop is bounded even while writers run.
+    // Each slot is read once, so the item compared is the one returned.
+    for (int probes = 0; probes < t->capacity; probes++) {
+        hashItem *item = t->slots[at].load(memory_order_acquire);
+        if (item == nullptr) {
+            break;
+        }
+        if (item != &deletedItem && item->hash == h && item->keyLength == key.size()
+            && memcmp(item->key(), key.data(), key.size()) == 0) {
+            if (pos != nullptr) {
+                *pos = at;
+            }
+            return item;
+        }
+        at = (at + 1) & mask;
+    }
+    return nullptr;
+}
+
+// Find item function
+concurrentTable::hashItem *concurrentTable::findItem(string_view key, size_t h) const {
+    return probe(shardOf(h).current.load(), key, h);
+}
+
+// New item function
+concurrentTable::hashItem *concurrentTable::newItem(shard &s, string_view key, size_t h, void *pv) {
+    size_t bytes = itemSize(key.size());
+    try {
+        if (s.chunks.empty() || s.chunkUsed + bytes > chunkSize) {
+            s.chunks.emplace_back(new char[max(chunkSize, bytes)]);
+            s.chunkUsed = 0;
+        }
+    } catch (const bad_alloc &) {
+        return nullptr;
+    }
+    char *at = s.chunks.back().get() + s.chunkUsed;
+    s.chunkUsed += bytes;
+
+    hashItem *item = new (at) hashItem;
+    item->hash = h;
+    item->pv.store(pv, memory_order_relaxed);
+    item->keyLength = key.size();
+    memcpy(at + sizeof(hashItem), key.data(), key.size());
+    return item;
+}
+
+// Rehash function
+bool concurrentTable::rehash(shard &s, int newCapacity) {
+    table *old = s.current.load(memory_order_relaxed);
+    unique_ptr<table> t;
+    try {
+        s.retired.reserve(s.retired.size() + 1);
+        t.reset(new table(newCapacity));
+    } catch (const bad_alloc &) {
+        return false;
+    }
+
+    // Copy the live items out when most of the chunk bytes are dead;
+    // the old chunks are retired with the old table
+    bool compact = s.deadBytes > s.liveBytes;
+    vector<unique_ptr<char[]>> oldChunks;
+    size_t oldChunkUsed = s.chunkUsed;
+    if (compact) {
+        oldChunks.swap(s.chunks);
+    }
+
+    // Fill the new table before publishing it, so readers
+    // only ever see a complete one
+    int mask = newCapacity - 1;
+    for (int i = 0; i < old->capacity; i++) {
+        hashItem *item = old->slots[i].load(memory_order_relaxed);
+        if (item != nullptr && item != &deletedItem) {
+            if (compact) {
+                item = newItem(s, string_view(item->key(), item->keyLength), item->hash,
+                               item->pv.load(memory_order_relaxed));
+                if (item == nullptr) {
+                    s.chunks.swap(oldChunks);
+                    s.chunkUsed = oldChunkUsed;
+                    return false;
+                }
+            }
+            int pos = slot(item->hash, t->shift);
+            while (t->slots[pos].load(memory_order_relaxed) != nullptr) {
+                pos = (pos + 1) & mask;
+            }
+            t->slots[pos].store(item, memory_order_relaxed);
+        }
+    }
+
+    // Sequentially consistent, like rcu's exchange, so a reader
+    // whose slot a later scan misses is sure to load the new table
+    s.current.store(t.release());
+    s.tombstones = 0;
+    if (compact) {
+        s.deadBytes = 0;
+    }
+
+    s.retired.push_back({unique_ptr<table>(old), move(oldChunks), readers.advance()});
+
+    // Free what every active reader started after; a reader that
+    // started later can only have loaded a newer table
+    uint64_t oldest = readers.oldest();
+    size_t kept = 0;
+    for (auto &memory : s.retired) {
+        if (memory.epoch >= oldest) {
+            if (&memory != &s.retired[kept]) {
+                s.retired[kept] = move(memory);
+            }
+            kept++;
+        }
+    }
+    s.retired.resize(kept);
+    return true;
+}
+
+// Get capacity function
+int concurrentTable::getCapacity(int size) {
+    int capacity = 16;
+    while (capacity / 2 < size && capacity < (1 << 30)) {
+        capacity <<= 1;
+    }
+    return capacity;
+}
+
+// Get shift function
+int concurrentTable::getShift(int capacity) {
+    int shift = 64;
+    while (capacity > 1) {
+        capacity >>= 1;
+        shift--;
+    }
+    return shift;
+}
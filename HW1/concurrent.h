@@ -0,0 +1,225 @@
+#ifndef _CONCURRENT_H
+#define _CONCURRENT_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "rcu.h"
+
+// A hash table with the hashTable interface that many threads may
+// use at once. Keys are split over a fixed number of shards by the
+// low bits of their hash; each shard is a linear probing table with
+// its own writer lock.
+//
+// Readers never lock: contains and getPointer read the shard's
+// current table and the items in it through atomic pointers, and
+// finish in a bounded number of probes however many writers are
+// running. Writers of the same shard take turns; writers of
+// different shards run in parallel.
+//
+// A full shard publishes a new table of pointers to its live items,
+// and a shard whose removed items take up more room than its live
+// ones copies the live items into fresh chunks as it does so. The
+// old table and chunks are retired rather than freed, since a reader
+// may still be probing them, and are freed by a later rehash (or the
+// destructor) once every reader that started before the swap is
+// done, as tracked by readerEpochs. Memory therefore stays in
+// proportion to the live items under any mix of inserts and removes.
+class concurrentTable {
+
+ public:
+
+  // The constructor initializes the hash table with room
+  // for at least the specified number of items, spread over
+  // the shards.
+  concurrentTable(int size = 0);
+  ~concurrentTable();
+
+  concurrentTable(const concurrentTable &) = delete;
+  concurrentTable &operator=(const concurrentTable &) = delete;
+
+  // Insert the specified key into the hash table.
+  // If an optional pointer is provided,
+  // associate that pointer with the key.
+  // Returns 0 on success,
+  // 1 if key already exists in hash table,
+  // 2 if rehash fails.
+  int insert(std::string_view key, void *pv = nullptr);
+
+  // Check if the specified key is in the hash table.
+  // If so, return true; otherwise, return false.
+  bool contains(std::string_view key) const;
+
+  // Get the pointer associated with the specified key.
+  // If the key does not exist in the hash table, return nullptr.
+  // If an optional pointer to a bool is provided,
+  // set the bool to true if the key is in the hash table,
+  // and set the bool to false otherwise.
+  void *getPointer(std::string_view key, bool *b = nullptr) const;
+
+  // Set the pointer associated with the specified key.
+  // Takes the shard's writer lock.
+  // Returns 0 on success,
+  // 1 if the key does not exist in the hash table.
+  int setPointer(std::string_view key, void *pv);
+
+  // Delete the item with the specified key.
+  // Returns true on success,
+  // false if the specified key is not in the hash table.
+  bool remove(std::string_view key);
+
+  // Look up count keys at once. found[i] (or pointers[i]) is set as
+  // contains (or getPointer) would for keys[i]. All hashes of a group
+  // are computed and their slots prefetched before any is probed,
+  // so the cache misses of independent lookups overlap.
+  void containsBatch(const std::string_view *keys, std::size_t count, bool *found) const;
+  void getPointerBatch(const std::string_view *keys, std::size_t count, void **pointers) const;
+
+  // Number of items in the hash table. Exact only when no
+  // insert or remove is running.
+  std::size_t size() const;
+
+ private:
+
+  // An item as stored; its characters follow it in memory.
+  // Only pv changes after the item is published.
+  class hashItem {
+  public:
+    std::size_t hash;
+    std::atomic<void *> pv;
+    std::uint32_t keyLength;
+
+    const char *key() const { return reinterpret_cast<const char *>(this + 1); }
+  };
+
+  // A power of two array of item pointers. An empty slot is
+  // nullptr; a removed item's slot points to deletedItem.
+  class table {
+  public:
+    int capacity;
+    int shift; // 64 - log2(capacity); see slot().
+    std::unique_ptr<std::atomic<hashItem *>[]> slots;
+
+    table(int capacity);
+  };
+
+  // A table, and the chunks its items were in if they were copied
+  // out, replaced at the specified epoch and waiting for the readers
+  // that might still hold them.
+  class retiredMemory {
+  public:
+    std::unique_ptr<table> slots;
+    std::vector<std::unique_ptr<char[]>> chunks;
+    std::uint64_t epoch;
+  };
+
+  // One shard: its current table, its writer lock and the memory
+  // it has retired. Shards are kept on separate cache lines so
+  // writers of neighbouring shards do not slow each other down.
+  class alignas(64) shard {
+  public:
+    std::atomic<table *> current {nullptr};
+    std::mutex writeLock;
+    int filled {0}; // Live items; written under writeLock.
+    int tombstones {0}; // Slots pointing to deletedItem.
+    std::atomic<std::size_t> count {0}; // Copy of filled for size().
+    std::vector<retiredMemory> retired;
+    std::vector<std::unique_ptr<char[]>> chunks; // Item storage.
+    std::size_t chunkUsed {0}; // Bytes used in the last chunk.
+    std::size_t liveBytes {0}; // Chunk bytes of live items.
+    std::size_t deadBytes {0}; // Chunk bytes of removed items.
+  };
+
+  // Marks the calling thread as a reader of the table for as long
+  // as it exists.
+  class readGuard {
+  public:
+    explicit readGuard(const readerEpochs &epochs) : epochs(epochs), slot(epochs.enter()) {}
+    ~readGuard() { epochs.leave(slot); }
+
+    readGuard(const readGuard &) = delete;
+    readGuard &operator=(const readGuard &) = delete;
+
+  private:
+    const readerEpochs &epochs;
+    int slot;
+  };
+
+  // Number of shards; a power of two, and well above the number
+  // of cores so that writers rarely wait for each other.
+  static const int shardBits = 6;
+  static const int shardCount = 1 << shardBits;
+
+  // Size of the blocks items are carved from.
+  static constexpr std::size_t chunkSize = 64 * 1024;
+
+  // Number of lookups a batch call hashes and prefetches together.
+  static const int batchGroup = 16;
+
+  std::unique_ptr<shard[]> shards;
+
+  // The readers active on any shard.
+  readerEpochs readers;
+
+  // Marks the slot of a removed item so probe chains stay intact.
+  static hashItem deletedItem;
+
+  // The hash function; returns the full hash value of key.
+  static std::size_t hash(std::string_view key);
+
+  // The shard of hash value h: its low bits, which slot() does not use.
+  shard &shardOf(std::size_t h) const { return shards[h & (shardCount - 1)]; }
+
+  // The home slot of hash value h in a table with the given shift:
+  // the top bits of h multiplied by 2^64 / golden ratio.
+  static int slot(std::size_t h, int shift) {
+    return (static_cast<std::uint64_t>(h) * 0x9E3779B97F4A7C15ull) >> shift;
+  }
+
+  // Search a table for the item with the specified key and hash
+  // value. Return the item if found (and its slot in pos, if given),
+  // nullptr otherwise. Safe to call without the writer lock, from
+  // within a readGuard.
+  static hashItem *probe(const table *t, std::string_view key, std::size_t h,
+                         int *pos = nullptr);
+
+  // Return the item with the specified key, or nullptr.
+  // Called within a readGuard or with the shard's writer lock held.
+  hashItem *findItem(std::string_view key, std::size_t h) const;
+
+  // Find the items for count keys, batchGroup at a time.
+  // Called within a readGuard.
+  void findBatch(const std::string_view *keys, std::size_t count, hashItem **items) const;
+
+  // Bytes an item with a key of the specified length takes in a chunk.
+  static std::size_t itemSize(std::size_t keyLength) {
+    return (sizeof(hashItem) + keyLength + alignof(hashItem) - 1) & ~(alignof(hashItem) - 1);
+  }
+
+  // Copy key into the shard's chunks as a new item.
+  // Called with the writer lock held.
+  static hashItem *newItem(shard &s, std::string_view key, std::size_t h, void *pv);
+
+  // Publish a table of the specified capacity holding the live items
+  // of the shard's current table, retire the old one, and free what
+  // the shard retired earlier that no reader can still hold. When
+  // removed items take up more chunk bytes than live ones, the live
+  // items are copied into fresh chunks and the old chunks retired too.
+  // Called with the writer lock held.
+  // Returns true on success, false if memory allocation fails.
+  bool rehash(shard &s, int newCapacity);
+
+  // Return the smallest power of two capacity (at least 16)
+  // that keeps size items at or below half full.
+  static int getCapacity(int size);
+
+  // Return 64 - log2(capacity) for a power of two capacity.
+  static int getShift(int capacity);
+};
+
+#endif //_CONCURRENT_H
@@ -1,17 +1,36 @@
 #ifndef _HASH_H
 #define _HASH_H
 
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
 #include <vector>
 #include <string>
+#include <string_view>
+#include "hashmap.h"
 
-class hashTable {
+// The string-keyed hash table, with an untyped pointer per key.
+// It is the hashMap specialization for std::string keys and void *
+// values, and is also known by its original name, hashTable.
+template <>
+class hashMap<std::string, void *> {
 
  public:
 
+  // Options for the constructor's flags argument.
+  // BACKSHIFT - remove items by shifting the rest of their probe
+  //             chain back instead of leaving a tombstone; suits
+  //             tables with heavy insert/remove churn (e.g. heaps).
+  // INCREMENTAL - resize by moving a few slots into the new table on
+  //               every insert and remove instead of all at once, so
+  //               no single insert pays for the whole rehash.
+  enum { BACKSHIFT = 1, INCREMENTAL = 2 };
+
   // The constructor initializes the hash table.
-  // Uses getPrime to choose a prime number at least as large as
-  // the specified size for the initial size of the hash table.
-  hashTable(int size = 0);
+  // Uses getCapacity to choose a power of two capacity with room
+  // for the specified number of items; the table grows by doubling
+  // from there, so small tables stay small.
+  hashMap(int size = 0, int flags = 0);
 
   // Insert the specified key into the hash table.
   // If an optional pointer is provided,
@@ -19,33 +38,92 @@ class hashTable {
   // Returns 0 on success,
   // 1 if key already exists in hash table,
   // 2 if rehash fails.
-  int insert(const std::string &key, void *pv = nullptr);
+  int insert(std::string_view key, void *pv = nullptr);
 
   // Check if the specified key is in the hash table.
   // If so, return true; otherwise, return false.
-  bool contains(const std::string &key);
+  bool contains(std::string_view key) const;
 
   // Get the pointer associated with the specified key.
   // If the key does not exist in the hash table, return nullptr.
   // If an optional pointer to a bool is provided,
   // set the bool to true if the key is in the hash table,
   // and set the bool to false otherwise.
-  void *getPointer(const std::string &key, bool *b = nullptr);
+  void *getPointer(std::string_view key, bool *b = nullptr) const;
 
   // Set the pointer associated with the specified key.
   // Returns 0 on success,
   // 1 if the key does not exist in the hash table.
-  int setPointer(const std::string &key, void *pv);
+  int setPointer(std::string_view key, void *pv);
 
   // Delete the item with the specified key.
   // Returns true on success,
   // false if the specified key is not in the hash table.
-  bool remove(const std::string &key);
+  bool remove(std::string_view key);
+
+  // Look up count keys at once. found[i] (or pointers[i]) is set as
+  // contains (or getPointer) would for keys[i]. All hashes of a group
+  // are computed and their slots prefetched before any is probed,
+  // so the cache misses of independent lookups overlap.
+  void containsBatch(const std::string_view *keys, std::size_t count, bool *found) const;
+  void getPointerBatch(const std::string_view *keys, std::size_t count, void **pointers) const;
+
+  // The same operations on a key given as a pointer and length,
+  // e.g. a word inside a line buffer; nothing is allocated unless
+  // the key is actually inserted.
+  int insert(const char *key, std::size_t len, void *pv = nullptr)
+    { return insert(std::string_view(key, len), pv); }
+  bool contains(const char *key, std::size_t len) const
+    { return contains(std::string_view(key, len)); }
+  void *getPointer(const char *key, std::size_t len, bool *b = nullptr) const
+    { return getPointer(std::string_view(key, len), b); }
+  int setPointer(const char *key, std::size_t len, void *pv)
+    { return setPointer(std::string_view(key, len), pv); }
+  bool remove(const char *key, std::size_t len)
+    { return remove(std::string_view(key, len)); }
+
+  // A snapshot of how the table is doing, for tuning its capacity
+  // and hash function. The probe length of an item is the number of
+  // slots a lookup of it reads (1 if it sits in its home slot);
+  // probeHistogram[i] counts the live items with probe length i + 1,
+  // and its last entry also counts every longer one. Only the
+  // current table is measured while an incremental resize runs.
+  //
+  // The counters at the end are only kept when the table is built
+  // with -DHASH_STATS (make stats); otherwise they stay zero and
+  // the table does no extra work.
+  class stats {
+  public:
+    std::size_t capacity {0};
+    std::size_t filled {0};
+    std::size_t tombstones {0};
+    double loadFactor {0}; // (filled + tombstones) / capacity
+    double averageProbe {0};
+    std::size_t maxProbe {0};
+    std::vector<std::size_t> probeHistogram;
+    std::size_t keyBytes {0}; // Size of the key arena.
+    std::size_t deadBytes {0}; // Bytes of removed keys in the arena.
+    bool migrating {false}; // An incremental resize is running.
+
+    std::size_t lookups {0}; // Number of probe sequences run.
+    std::size_t lookupProbes {0}; // Occupied slots they read.
+    std::size_t rehashes {0}; // Number of rebuilds and migrations.
+    double rehashSeconds {0}; // Time spent moving items.
+
+    // Write the statistics to out, one per line.
+    void print(std::ostream &out) const;
+  };
+
+  // Return the current statistics. Scans the whole table.
+  stats getStats() const;
 
  private:
 
   // Each item in the hash table contains:
-  // key - a string used as a key.
+  // hash - the full hash value of the key; compared before
+  //        the key itself, and reused when the table is resized.
+  // keyOffset, keyLength - where the key's characters are stored
+  //                        in the table's key arena.
   // isOccupied - if false, this entry is empty,
   //              and the other fields are meaningless.
   // isDeleted - if true, this item has been lazily deleted.
@@ -53,7 +131,9 @@ class hashTable {
   //      nullptr if no pointer was provided to insert.
   class hashItem {
   public:
-    std::string key {""};
+    std::size_t hash {0};
+    std::uint32_t keyOffset {0};
+    std::uint32_t keyLength {0};
     bool isOccupied {false};
     bool isDeleted {false};
     void *pv {nullptr};
@@ -61,25 +141,116 @@ class hashTable {
     hashItem() = default;
   };
 
-  int capacity; // The current capacity of the hash table.
-  int filled; // Number of occupied items in the table.
+  int capacity; // The current capacity of the hash table; a power of two.
+  int shift; // 64 - log2(capacity); see slot().
+  int filled; // Number of live items in the table.
+  int tombstones; // Number of lazily deleted items in the table.
+  int flags; // Options passed to the constructor.
 
   std::vector<hashItem> data; // The actual entries are here.
 
-  // The hash function.
-  int hash(const std::string &key);
+  // The characters of every key in data, back to back. Removed keys
+  // stay until the next rehash copies the live ones to a new arena;
+  // deadBytes counts them so the table can purge when they pile up.
+  std::vector<char> keys;
+  std::size_t deadBytes;
+
+  // During an incremental resize the previous table is kept here,
+  // together with its key arena. Slots below migrated have been
+  // moved to data already; they are left as tombstones so that
+  // old probe chains stay intact.
+  std::vector<hashItem> oldData;
+  std::vector<char> oldKeys;
+  int oldCapacity; // Capacity of oldData; 0 if no resize is running.
+  int oldShift; // The shift that goes with oldCapacity.
+  int migrated; // Number of oldData slots moved so far.
+
+  // Number of oldData slots moved per insert or remove. A resize
+  // must finish well before the new table reaches its own limit.
+  static const int migrateStep = 8;
+
+  // Number of probeHistogram entries returned by getStats.
+  static const int histogramSize = 16;
+
+#ifdef HASH_STATS
+  // Counters reported by getStats; see stats. Lookups update them,
+  // so a table built with HASH_STATS must not be read from several
+  // threads at once.
+  mutable std::size_t lookupCount {0};
+  mutable std::size_t probeCount {0};
+  std::size_t rehashCount {0};
+  double rehashTime {0};
+#endif
+
+  // The hash function; returns the full hash value of key.
+  static std::size_t hash(std::string_view key);
+
+  // The home slot of hash value h in a table with the given shift:
+  // the top bits of h multiplied by 2^64 / golden ratio, which
+  // spreads the hash over the table without a division.
+  static int slot(std::size_t h, int shift) {
+    return (static_cast<std::uint64_t>(h) * 0x9E3779B97F4A7C15ull) >> shift;
+  }
 
-  // Search for an item with the specified key.
+  // Search for an item with the specified key and hash value.
   // Return the position if found, -1 otherwise.
-  int findPos(const std::string &key);
+  int findPos(std::string_view key, std::size_t h) const;
 
-  // The rehash function; makes the hash table bigger.
+  // Search oldData for an item with the specified key and hash value.
+  // Return the position if found, -1 otherwise.
+  int findOldPos(std::string_view key, std::size_t h) const;
+
+  // Linear probe shared by findPos and findOldPos.
+  int probe(const std::vector<hashItem> &table, int shift,
+            const std::vector<char> &arena, std::string_view key, std::size_t h) const;
+
+  // Return the item with the specified key (and hash value, if
+  // already known) from either table, or nullptr if it is not present.
+  const hashItem *findItem(std::string_view key) const;
+  const hashItem *findItem(std::string_view key, std::size_t h) const;
+
+  // Number of lookups a batch call hashes and prefetches together.
+  static const int batchGroup = 16;
+
+  // Find the items for count keys, batchGroup at a time.
+  void findBatch(const std::string_view *keys, std::size_t count, const hashItem **items) const;
+
+  // Copy key into the arena and place a new item for it.
+  // Returns false if the arena is full.
+  bool addItem(std::string_view key, std::size_t h, void *pv);
+
+  // Copy an item into the first free slot of its probe chain in
+  // data. The key must already be in the arena and not in the table.
+  void placeItem(const hashItem &item);
+
+  // Empty the slot at pos, then walk the rest of its probe chain
+  // and move back every item whose home slot allows it, so that
+  // no tombstone is needed.
+  void shiftBack(int pos);
+
+  // The rehash function; rebuilds the table with the specified
+  // power of two capacity, dropping all tombstones and dead key bytes.
+  // Called with the current capacity, it purges them in place.
+  // Returns true on success, false if memory allocation fails.
+  bool rehash(int newCapacity);
+
+  // Begin an incremental resize to the specified power of two capacity;
+  // the current table and arena become oldData and oldKeys.
   // Returns true on success, false if memory allocation fails.
-  bool rehash();
+  bool startMigration(int newCapacity);
 
-  // Return a prime number at least as large as size.
-  // Uses a precomputed sequence of selected prime numbers.
-  static unsigned int getPrime(int size);
+  // Move up to count slots of oldData into data, releasing oldData
+  // once every slot has been moved.
+  void migrate(int count);
+
+  // Return the smallest power of two capacity (at least 16)
+  // that keeps size items at or below half full.
+  static int getCapacity(int size);
+
+  // Return 64 - log2(capacity) for a power of two capacity.
+  static int getShift(int capacity);
 };
 
+typedef hashMap<std::string, void *> hashTable;
+
 #endif //_HASH_H
\ No newline at end of file
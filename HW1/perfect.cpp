@@ -0,0 +1,328 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "perfect.h"
+using namespace std;
+
+const char perfectHash::magicValue[8] = {'S', 'P', 'E', 'L', 'L', 'M', 'P', 'H'};
+
+// Destructor
+perfectHash::~perfectHash() {
+    unload();
+}
+
+// Write function
+bool perfectHash::write(vector<string> keys, const string &filename) {
+    sort(keys.begin(), keys.end());
+    keys.erase(unique(keys.begin(), keys.end()), keys.end());
+
+    uint32_t count = keys.size();
+    uint32_t numBuckets = max<uint32_t>(1, count / bucketLoad + 1);
+    uint32_t size = max<uint32_t>(1, count / tableLoad + 1);
+
+    vector<uint16_t> pilot(numBuckets);
+    vector<uint32_t> slotOf(count);
+    uint64_t keySeed = 0x5eed;
+
+    // Try seeds until every bucket finds a pilot; with these loads
+    // the first seed almost always works
+    while (true) {
+        vector<uint64_t> hashes(count);
+        vector<pair<uint32_t, uint32_t>> byBucket(count); // (bucket, key)
+        for (uint32_t i = 0; i < count; i++) {
+            hashes[i] = hash(keys[i], keySeed);
+            byBucket[i] = {reduce(hashes[i], numBuckets), i};
+        }
+        sort(byBucket.begin(), byBucket.end());
+
+        // Place the largest buckets first, while the table is emptiest
+        vector<pair<uint32_t, uint32_t>> ranges; // (start, end) in byBucket
+        for (uint32_t i = 0, j; i < count; i = j) {
+            for (j = i; j < count && byBucket[j].first == byBucket[i].first; j++);
+            ranges.push_back({i, j});
+        }
+        stable_sort(ranges.begin(), ranges.end(),
+            [](const pair<uint32_t, uint32_t> &a, const pair<uint32_t, uint32_t> &b) {
+                return a.second - a.first > b.second - b.first;
+            });
+
+        vector<bool> taken(size);
+        vector<uint32_t> slots;
+        bool done = true;
+        for (const auto &range : ranges) {
+            uint32_t b = byBucket[range.first].first;
+            bool placed = false;
+            for (uint32_t p = 0; p <= 0xffff && !placed; p++) {
+                slots.clear();
+                placed = true;
+                for (uint32_t k = range.first; k < range.second && placed; k++) {
+                    uint32_t s = position(hashes[byBucket[k].second], p, size);
+                    if (taken[s] || find(slots.begin(), slots.end(), s) != slots.end()) {
+                        placed = false;
+                    }
+                    slots.push_back(s);
+                }
+                if (placed) {
+                    pilot[b] = p;
+                    for (uint32_t k = range.first; k < range.second; k++) {
+                        uint32_t s = slots[k - range.first];
+                        taken[s] = true;
+                        slotOf[byBucket[k].second] = s;
+                    }
+                }
+            }
+            if (!placed) {
+                done = false;
+                break;
+            }
+        }
+        if (done) {
+            break;
+        }
+        keySeed++;
+    }
+
+    // Slots at or past count are remapped onto the free slots
+    // below count, which makes the hash minimal
+    vector<uint32_t> remapTable(size - count);
+    {
+        vector<bool> used(size);
+        for (uint32_t s : slotOf) {
+            used[s] = true;
+        }
+        uint32_t nextFree = 0;
+        for (uint32_t s = count; s < size; s++) {
+            if (used[s]) {
+                while (used[nextFree]) {
+                    nextFree++;
+                }
+                remapTable[s - count] = nextFree++;
+            }
+        }
+        for (uint32_t &s : slotOf) {
+            if (s >= count) {
+                s = remapTable[s - count];
+            }
+        }
+    }
+
+    // Pack the words in slot order
+    vector<uint32_t> order(count);
+    for (uint32_t i = 0; i < count; i++) {
+        order[slotOf[i]] = i;
+    }
+    vector<uint32_t> offsetTable(count + 1);
+    string packed;
+    for (uint32_t s = 0; s < count; s++) {
+        offsetTable[s] = packed.size();
+        packed += keys[order[s]];
+    }
+    offsetTable[count] = packed.size();
+
+    header h;
+    memcpy(h.magic, magicValue, sizeof(h.magic));
+    h.version = versionValue;
+    h.n = count;
+    h.tableSize = size;
+    h.buckets = numBuckets;
+    h.seed = keySeed;
+    h.wordBytes = packed.size();
+
+    ofstream outFile(filename, ios::binary | ios::trunc);
+    if (!outFile) {
+        return false;
+    }
+    const char zeros[8] = {};
+    auto put = [&](const void *p, size_t bytes) {
+        outFile.write(static_cast<const char *>(p), bytes);
+        outFile.write(zeros, align8(bytes) - bytes);
+    };
+    put(&h, sizeof(h));
+    put(pilot.data(), pilot.size() * sizeof(uint16_t));
+    put(remapTable.data(), remapTable.size() * sizeof(uint32_t));
+    put(offsetTable.data(), offsetTable.size() * sizeof(uint32_t));
+    put(packed.data(), packed.size());
+    return static_cast<bool>(outFile);
+}
+
+// Is dictionary file function
+bool perfectHash::isDictionaryFile(const string &filename) {
+    ifstream inFile(filename, ios::binary);
+    char magic[sizeof(magicValue)];
+    return inFile.read(magic, sizeof(magic))
+        && memcmp(magic, magicValue, sizeof(magic)) == 0;
+}
+
+// Load function
+bool perfectHash::load(const string &filename) {
+    unload();
+
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(header)) {
+        close(fd);
+        return false;
+    }
+    void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        return false;
+    }
+    region = p;
+    regionSize = st.st_size;
+
+    // Check the header and that every array fits in the file
+    const header *h = static_cast<const header *>(region);
+    if (memcmp(h->magic, magicValue, sizeof(magicValue)) != 0
+        || h->version != versionValue || h->tableSize < h->n || h->buckets == 0) {
+        unload();
+        return false;
+    }
+    const char *base = static_cast<const char *>(region);
+    size_t at = align8(sizeof(header));
+    size_t pilotsAt = at;
+    at += align8(size_t(h->buckets) * sizeof(uint16_t));
+    size_t remapAt = at;
+    at += align8(size_t(h->tableSize - h->n) * sizeof(uint32_t));
+    size_t offsetsAt = at;
+    at += align8((size_t(h->n) + 1) * sizeof(uint32_t));
+    size_t wordsAt = at;
+    if (wordsAt > regionSize || h->wordBytes > regionSize - wordsAt) {
+        unload();
+        return false;
+    }
+
+    n = h->n;
+    tableSize = h->tableSize;
+    buckets = h->buckets;
+    seed = h->seed;
+    pilots = reinterpret_cast<const uint16_t *>(base + pilotsAt);
+    remap = reinterpret_cast<const uint32_t *>(base + remapAt);
+    offsets = reinterpret_cast<const uint32_t *>(base + offsetsAt);
+    words = base + wordsAt;
+
+    // Lookups index with these arrays unchecked, so every word must
+    // lie inside the packed words and every remapped slot below n
+    // (an empty dictionary is never looked up in)
+    if (offsets[0] != 0 || offsets[n] != h->wordBytes) {
+        unload();
+        return false;
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        if (offsets[i] > offsets[i + 1]) {
+            unload();
+            return false;
+        }
+    }
+    for (uint32_t i = 0; n > 0 && i < tableSize - n; i++) {
+        if (remap[i] >= n) {
+            unload();
+            return false;
+        }
+    }
+    return true;
+}
+
+// Contains function
+bool perfectHash::contains(string_view key) const {
+    if (n == 0) {
+        return false;
+    }
+    return matches(key, slotOf(hash(key, seed)));
+}
+
+// Contains batch function
+void perfectHash::containsBatch(const string_view *keys, size_t count, bool *found) const {
+    if (n == 0) {
+        fill(found, found + count, false);
+        return;
+    }
+    uint64_t hashes[batchGroup];
+    uint32_t slots[batchGroup];
+    for (size_t i = 0; i < count; i += batchGroup) {
+        size_t group = min<size_t>(batchGroup, count - i);
+        for (size_t j = 0; j < group; j++) {
+            hashes[j] = hash(keys[i + j], seed);
+            __builtin_prefetch(&pilots[reduce(hashes[j], buckets)]);
+        }
+        for (size_t j = 0; j < group; j++) {
+            slots[j] = slotOf(hashes[j]);
+            __builtin_prefetch(&offsets[slots[j]]);
+        }
+        for (size_t j = 0; j < group; j++) {
+            found[i + j] = matches(keys[i + j], slots[j]);
+        }
+    }
+}
+
+// Slot of function
+uint32_t perfectHash::slotOf(uint64_t h) const {
+    uint32_t s = position(h, pilots[reduce(h, buckets)], tableSize);
+    if (s >= n) {
+        s = remap[s - n];
+    }
+    return s;
+}
+
+// Matches function
+bool perfectHash::matches(string_view key, uint32_t s) const {
+    uint32_t start = offsets[s];
+    uint32_t length = offsets[s + 1] - start;
+    return length == key.size() && memcmp(words + start, key.data(), length) == 0;
+}
+
+// Unload function
+void perfectHash::unload() {
+    if (region != nullptr) {
+        munmap(region, regionSize);
+    }
+    region = nullptr;
+    regionSize = 0;
+    n = tableSize = buckets = 0;
+    pilots = nullptr;
+    remap = offsets = nullptr;
+    words = nullptr;
+}
+
+// Hash function
+uint64_t perfectHash::hash(string_view key, uint64_t seed) {
+    uint64_t h = seed ^ (key.size() * 0x9E3779B97F4A7C15ull);
+    size_t i = 0;
+    for (; i + 8 <= key.size(); i += 8) {
+        uint64_t word;
+        memcpy(&word, key.data() + i, 8);
+        h = mix(h ^ word);
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, key.data() + i, key.size() - i);
+    return mix(h ^ tail);
+}
+
+// Mix function
+uint64_t perfectHash::mix(uint64_t x) {
+    x ^= x >> 32;
+    x *= 0xd6e8feb86659fd93ull;
+    x ^= x >> 32;
+    x *= 0xd6e8feb86659fd93ull;
+    x ^= x >> 32;
+    return x;
+}
+
+// Reduce function
+uint32_t perfectHash::reduce(uint64_t x, uint32_t range) {
+    return (uint32_t)((x >> 32) * range >> 32);
+}
+
+// Position function
+uint32_t perfectHash::position(uint64_t h, uint16_t pilot, uint32_t tableSize) {
+    return reduce(mix(h ^ (pilot * 0x9E3779B97F4A7C15ull + 1)), tableSize);
+}
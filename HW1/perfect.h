@@ -0,0 +1,125 @@
+#ifndef _PERFECT_H
+#define _PERFECT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A read-only dictionary stored as a minimal perfect hash.
+//
+// write() compiles a list of words into a file; load() maps that file
+// into memory and the dictionary can be queried right away, with no
+// parsing or table building. Each key hashes to a bucket, and each
+// bucket stores a small "pilot" value chosen at build time so that
+// its keys land on distinct slots (hash-and-displace). Every slot
+// holds exactly one word, so a lookup is one hash, one pilot, and
+// one comparison against the packed word at that slot.
+//
+// The file is written in the byte order of the machine that built
+// it and is only meant to be loaded on the same kind of machine.
+class perfectHash {
+
+ public:
+
+  perfectHash() = default;
+  ~perfectHash();
+
+  perfectHash(const perfectHash &) = delete;
+  perfectHash &operator=(const perfectHash &) = delete;
+
+  // Build a perfect hash over the specified words and write it to
+  // filename. Duplicate words are dropped.
+  // Returns true on success, false if the file cannot be written.
+  static bool write(std::vector<std::string> keys, const std::string &filename);
+
+  // Check whether filename starts with the dictionary file header.
+  static bool isDictionaryFile(const std::string &filename);
+
+  // Map a file produced by write() into memory. The header, the
+  // word offsets and the remap table are checked before use, so a
+  // truncated or corrupted file is rejected rather than read out of
+  // bounds.
+  // Returns true on success, false if the file cannot be opened
+  // or is not a valid dictionary file.
+  bool load(const std::string &filename);
+
+  // Check if the specified key is in the dictionary.
+  bool contains(std::string_view key) const;
+
+  // Look up count keys at once; found[i] is set as contains would
+  // for keys[i]. The bucket pilots and then the word offsets of a
+  // group are prefetched before they are read, so the cache misses
+  // of independent lookups overlap.
+  void containsBatch(const std::string_view *keys, std::size_t count, bool *found) const;
+
+  // Number of words in the dictionary.
+  std::size_t size() const { return n; }
+
+ private:
+
+  // The file starts with this header; the arrays follow it in the
+  // order listed, each starting on an 8-byte boundary:
+  // pilots[buckets] (uint16), remap[tableSize - n] (uint32),
+  // offsets[n + 1] (uint32), then the packed words.
+  class header {
+  public:
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t n; // Number of words.
+    std::uint32_t tableSize; // Slots probed by the pilots (>= n).
+    std::uint32_t buckets; // Number of buckets.
+    std::uint64_t seed; // Seed of the key hash.
+    std::uint64_t wordBytes; // Size of the packed words.
+  };
+
+  static const char magicValue[8];
+  static constexpr std::uint32_t versionValue = 1;
+
+  // Average number of keys per bucket, and the fraction of the
+  // table filled before slots past n are remapped below n.
+  static constexpr double bucketLoad = 4.0;
+  static constexpr double tableLoad = 0.97;
+
+  // Number of lookups containsBatch works on together.
+  static const int batchGroup = 16;
+
+  // The mapped file and views into it.
+  void *region {nullptr};
+  std::size_t regionSize {0};
+  std::uint32_t n {0};
+  std::uint32_t tableSize {0};
+  std::uint32_t buckets {0};
+  std::uint64_t seed {0};
+  const std::uint16_t *pilots {nullptr};
+  const std::uint32_t *remap {nullptr};
+  const std::uint32_t *offsets {nullptr};
+  const char *words {nullptr};
+
+  // Unmap the current file, if any.
+  void unload();
+
+  // The key hash; reads the key eight bytes at a time.
+  static std::uint64_t hash(std::string_view key, std::uint64_t seed);
+
+  // A 64-bit finalizer used to scramble hash values.
+  static std::uint64_t mix(std::uint64_t x);
+
+  // Map a 64-bit value uniformly onto [0, range).
+  static std::uint32_t reduce(std::uint64_t x, std::uint32_t range);
+
+  // The slot of a key with hash h in a bucket with the specified pilot.
+  static std::uint32_t position(std::uint64_t h, std::uint16_t pilot, std::uint32_t tableSize);
+
+  // The final slot (below n) of a key with hash h.
+  std::uint32_t slotOf(std::uint64_t h) const;
+
+  // Compare key with the word stored in slot s.
+  bool matches(std::string_view key, std::uint32_t s) const;
+
+  // Round a byte count up to a multiple of 8.
+  static std::size_t align8(std::size_t size) { return (size + 7) & ~std::size_t(7); }
+};
+
+#endif //_PERFECT_H
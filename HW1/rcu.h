@@ -0,0 +1,204 @@
+#ifndef _RCU_H
+#define _RCU_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Tracks the threads reading a shared structure, so that memory a
+// writer has unlinked from it can be freed once no reader can still
+// hold it.
+//
+// Each active reader holds one of a fixed set of slots, stamped with
+// the epoch at which it started. A writer that unlinks memory calls
+// advance() and keeps the epoch it returns; the memory may be freed
+// once oldest() is above that epoch, that is, once every active
+// reader started after it. Up to readerSlots readers can be active
+// at once; further readers wait for a slot.
+class readerEpochs {
+
+ public:
+
+  // Claim a free reader slot, stamped with the current epoch,
+  // starting at one picked by thread so threads rarely collide.
+  // Claiming the slot before loading any shared pointer means a
+  // writer that sees the slot free has already unlinked what it
+  // is about to free. Pass the slot to leave() when done.
+  int enter() const {
+    std::size_t start = std::hash<std::thread::id>()(std::this_thread::get_id());
+    for (std::size_t i = 0; ; i++) {
+      int slot = (start + i) % readerSlots;
+      std::uint64_t expected = 0;
+      if (slots[slot].epoch.compare_exchange_strong(expected, epoch.load())) {
+        return slot;
+      }
+      if (i % readerSlots == readerSlots - 1) {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+  // Give back a slot claimed by enter().
+  void leave(int slot) const {
+    slots[slot].epoch.store(0, std::memory_order_release);
+  }
+
+  // Start a new epoch and return the previous one, at which memory
+  // unlinked before the call is retired.
+  std::uint64_t advance() {
+    return epoch.fetch_add(1);
+  }
+
+  // The start epoch of the oldest active reader, or UINT64_MAX if
+  // none is active; memory retired before it may be freed.
+  std::uint64_t oldest() const {
+    std::uint64_t oldest = UINT64_MAX;
+    for (int i = 0; i < readerSlots; i++) {
+      std::uint64_t started = slots[i].epoch.load();
+      if (started != 0 && started < oldest) {
+        oldest = started;
+      }
+    }
+    return oldest;
+  }
+
+ private:
+
+  static const int readerSlots = 64;
+
+  // An active reader's start epoch, or 0 if the slot is free.
+  // One slot per cache line, so readers do not slow each other down.
+  class alignas(64) readerSlot {
+  public:
+    std::atomic<std::uint64_t> epoch {0};
+  };
+
+  mutable readerSlot slots[readerSlots];
+  std::atomic<std::uint64_t> epoch {1};
+};
+
+// Holds the current version of a read-mostly object, such as a
+// loaded dictionary, and lets a new version replace it while other
+// threads keep reading (read-copy-update).
+//
+// A reader calls read() and uses the version it gets until the
+// returned guard goes away; it never takes a lock, and the version
+// it holds does not change under it. A writer builds a new version
+// on its own and hands it to publish(), which makes it current in
+// one atomic step. The old version is freed once no reader can
+// still be using it, as tracked by readerEpochs.
+template <typename T>
+class rcu {
+
+ public:
+
+  // Take ownership of the first version (which may be nullptr).
+  explicit rcu(T *initial = nullptr) : current(initial) {}
+
+  // Free the current version and every retired one.
+  // No reader may be active.
+  ~rcu() {
+    delete current.load();
+    for (auto &version : retired) {
+      delete version.first;
+    }
+  }
+
+  rcu(const rcu &) = delete;
+  rcu &operator=(const rcu &) = delete;
+
+  // A reader's hold on one version; the version stays valid
+  // until the guard is destroyed.
+  class reader {
+  public:
+    reader(reader &&other) : owner(other.owner), slot(other.slot), version(other.version) {
+      other.owner = nullptr;
+    }
+    ~reader() {
+      if (owner != nullptr) {
+        owner->epochs.leave(slot);
+      }
+    }
+
+    reader(const reader &) = delete;
+    reader &operator=(const reader &) = delete;
+
+    const T *get() const { return version; }
+    const T *operator->() const { return version; }
+    const T &operator*() const { return *version; }
+
+  private:
+    friend class rcu;
+    reader(const rcu *owner, int slot, const T *version)
+        : owner(owner), slot(slot), version(version) {}
+
+    const rcu *owner;
+    int slot;
+    const T *version;
+  };
+
+  // Start reading the current version.
+  reader read() const {
+    int slot = epochs.enter();
+    return reader(this, slot, current.load());
+  }
+
+  // Make next the current version. The previous one is retired,
+  // and freed by this or a later publish or reclaim once the
+  // readers that might hold it are done.
+  void publish(T *next) {
+    std::lock_guard<std::mutex> guard(writeLock);
+    T *old = current.exchange(next);
+    std::uint64_t retiredAt = epochs.advance();
+    if (old != nullptr) {
+      retired.push_back({old, retiredAt});
+    }
+    freeDrained();
+  }
+
+  // Free the retired versions no reader can still hold.
+  // Returns the number still waiting for their readers.
+  std::size_t reclaim() {
+    std::lock_guard<std::mutex> guard(writeLock);
+    freeDrained();
+    return retired.size();
+  }
+
+  // Wait until every version retired so far has been freed.
+  void synchronize() {
+    while (reclaim() != 0) {
+      std::this_thread::yield();
+    }
+  }
+
+ private:
+
+  readerEpochs epochs;
+  std::atomic<T *> current;
+
+  // Writers only: retired versions and the epoch they were retired at.
+  std::mutex writeLock;
+  std::vector<std::pair<T *, std::uint64_t>> retired;
+
+  // Free every retired version older than the oldest active reader.
+  // Called with writeLock held.
+  void freeDrained() {
+    std::uint64_t oldest = epochs.oldest();
+    std::size_t kept = 0;
+    for (auto &version : retired) {
+      if (version.second < oldest) {
+        delete version.first;
+      } else {
+        retired[kept++] = version;
+      }
+    }
+    retired.resize(kept);
+  }
+};
+
+#endif //_RCU_H
@@ -5,11 +5,38 @@
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <sys/stat.h>
 
 #include "hash.h"
+#include "swisstable.h"
+#include "perfect.h"
+#include "rcu.h"
+#include "bloom.h"
+#ifdef USE_CONCURRENT
+#include "concurrent.h"
+#endif
 
 using namespace std;
 
+// The dictionary engine; build with -DUSE_SWISS (make swiss)
+// to use the group-probed swissTable instead of hashTable, or with
+// -DUSE_CONCURRENT (make parallel) to load the dictionary from
+// several threads into a concurrentTable.
+#if defined(USE_CONCURRENT)
+typedef concurrentTable dictTable;
+#elif defined(USE_SWISS)
+typedef swissTable dictTable;
+#else
+typedef hashTable dictTable;
+#endif
+
 const regex regex_val = regex("^[A-Za-z'-] + $");
 // From cpp reference
 string str_tolower(string s) {
@@ -17,9 +44,13 @@ string str_tolower(string s) {
         [](unsigned char c) { return tolower(c); });
     return s;
 }
-// Insert dictionary into hash table
-hashTable* parse_dictionary(string filename) {
-    //const regex regex_val = regex("^[A-Za-z'-] + $");
+// Check if a dictionary line is a word that should be loaded
+bool is_dictionary_word(const string &line) {
+    static const regex regex_val = regex("^[A-Za-z'-]+$");
+    return line.size() <= 20 && regex_match(line, regex_val);
+}
+// Read the valid words of a dictionary file, lowercased
+vector<string> read_dictionary(string filename) {
     ifstream inFile;
     inFile.open(filename);
     string line;
@@ -28,72 +59,345 @@ hashTable* parse_dictionary(string filename) {
         throw invalid_argument(
             "\n File for dictionary failed to open:");
     }
-    int fsize = 0;
+    vector<string> words;
     while (getline(inFile, line)) {
-        fsize++;
+        if (is_dictionary_word(line)) {
+            words.push_back(str_tolower(line));
+        }
     }
     inFile.close();
-    const regex regex_val = regex("^[A-Za-z'-]+$");
+    return words;
+}
+#ifdef USE_CONCURRENT
+// Insert dictionary into hash table, one slice of the file per core;
+// the checking of each line is split up along with the inserts.
+// If a filter is provided, it is rebuilt to hold the same words.
+dictTable* parse_dictionary(string filename, bloomFilter *filter = nullptr) {
+    ifstream inFile;
     inFile.open(filename);
-    hashTable* table = new hashTable(fsize);
+    if (!inFile.is_open()) {
+        throw invalid_argument(
+            "\n File for dictionary failed to open:");
+    }
+    vector<string> lines;
+    string line;
     while (getline(inFile, line)) {
-        if (line.size() <= 20 && regex_match(line, regex_val)) {
-            string S = str_tolower(line);
-            table->insert(S);
-        }
+        lines.push_back(line);
     }
     inFile.close();
+
+    dictTable* table = new dictTable(lines.size());
+    size_t threads = max(1u, thread::hardware_concurrency());
+    size_t slice = (lines.size() + threads - 1) / threads;
+    vector<char> accepted(lines.size());
+    vector<thread> workers;
+    for (size_t t = 0; t < threads; t++) {
+        workers.emplace_back([&, t]() {
+            size_t end = min(lines.size(), (t + 1) * slice);
+            for (size_t i = t * slice; i < end; i++) {
+                if (is_dictionary_word(lines[i])) {
+                    lines[i] = str_tolower(lines[i]);
+                    table->insert(lines[i]);
+                    accepted[i] = true;
+                }
+            }
+        });
+    }
+    for (thread &worker : workers) {
+        worker.join();
+    }
+    // The filter is not thread safe, so it is filled afterwards
+    if (filter != nullptr) {
+        *filter = bloomFilter(table->size());
+        for (size_t i = 0; i < lines.size(); i++) {
+            if (accepted[i]) {
+                filter->insert(lines[i]);
+            }
+        }
+    }
+    return table;
+}
+#else
+// Insert dictionary into hash table.
+// If a filter is provided, it is rebuilt to hold the same words.
+dictTable* parse_dictionary(string filename, bloomFilter *filter = nullptr) {
+    vector<string> words = read_dictionary(filename);
+    dictTable* table = new dictTable(words.size());
+    if (filter != nullptr) {
+        *filter = bloomFilter(words.size());
+    }
+    for (const string &word : words) {
+        table->insert(word);
+        if (filter != nullptr) {
+            filter->insert(word);
+        }
+    }
     return table;
 }
+#endif
+// A parsed dictionary: the table, and optionally a Bloom filter in
+// front of it that turns away most unknown words with one cache
+// line read, so text full of misspellings or noise is checked
+// about as fast as clean text
+class dictionary {
+public:
+    unique_ptr<dictTable> table;
+    unique_ptr<bloomFilter> filter;
+
+    void containsBatch(const string_view *words, size_t count, bool *found) const {
+        if (filter == nullptr) {
+            table->containsBatch(words, count, found);
+            return;
+        }
+        // Only the words that pass the filter go on to the table
+        const size_t group = 64;
+        string_view maybe[group];
+        size_t index[group];
+        bool known[group];
+        for (size_t i = 0; i < count; i += group) {
+            size_t n = min(group, count - i);
+            filter->mayContainBatch(words + i, n, found + i);
+            size_t m = 0;
+            for (size_t j = 0; j < n; j++) {
+                if (found[i + j]) {
+                    maybe[m] = words[i + j];
+                    index[m++] = i + j;
+                }
+            }
+            table->containsBatch(maybe, m, known);
+            for (size_t j = 0; j < m; j++) {
+                found[index[j]] = known[j];
+            }
+        }
+    }
+};
+// Parse a dictionary file, with a filter if use_filter is set
+dictionary* load_dictionary(string filename, bool use_filter) {
+    dictionary* dict = new dictionary;
+    if (use_filter) {
+        dict->filter.reset(new bloomFilter);
+    }
+    dict->table.reset(parse_dictionary(filename, dict->filter.get()));
+    return dict;
+}
+// Valid word characters (after lowering): letters, dashes and apostrophes
+bool is_word_char(unsigned char c) {
+    return (c >= 'a' && c <= 'z') || c == '\'' || c == '-';
+}
+// Report a word that is too long or not in the dictionary
+void report_word(string_view word, bool known, int line_number, ofstream& outFile) {
+    if (word.size() > 20) {
+        outFile << "Long word at line " << to_string(line_number)
+                << ", starts: " << word.substr(0, 20) << "\n";
+    } else if (!known) {
+        outFile << "Unknown word at line " << to_string(line_number) << ": "
+                << word << "\n";
+    }
+}
 // Check if word is in dictionary 
-void spellcheck(string in_file, string out_file, hashTable& table) {
+template <typename Dict>
+void spellcheck(string in_file, string out_file, Dict& table) {
     ifstream inFile;
     inFile.open(in_file);
     ofstream outFile;
     outFile.open(out_file);
     string read_line;
 
-    const regex regex_val = regex("[A-Za-z'-]");
+    // The words of a line are looked up together so that the
+    // dictionary can overlap their cache misses
+    const size_t batchSize = 64;
+    string_view words[batchSize];
+    bool found[batchSize];
+    size_t count = 0;
     int line_number = 0;
+    auto flush = [&]() {
+        table.containsBatch(words, count, found);
+        for (size_t w = 0; w < count; w++) {
+            report_word(words[w], found[w], line_number, outFile);
+        }
+        count = 0;
+    };
+    auto add_word = [&](string_view word) {
+        if (word.size() > 0) {
+            words[count++] = word;
+        }
+        if (count == batchSize) {
+            flush();
+        }
+    };
+
     while (getline(inFile, read_line)) {
         line_number++;
-        int i = 0;
-        string word = "";
+        // Lowercase the whole line so words can be looked up
+        // directly from the line buffer without copying them
+        transform(read_line.begin(), read_line.end(), read_line.begin(),
+            [](unsigned char c) { return tolower(c); });
+        const char *line = read_line.data();
+        size_t start = 0;
         bool shouldCheck = true;
-        for (int i = 0; i < read_line.size(); i++) {
-            string num = string(1, tolower(read_line[i]));
-            if (regex_match(num, regex_val) > 0 || isdigit(read_line[i]) > 0) {
-                if (isdigit(read_line[i])) {
+        for (size_t i = 0; i < read_line.size(); i++) {
+            unsigned char c = line[i];
+            if (is_word_char(c) || isdigit(c)) {
+                if (isdigit(c)) {
                     shouldCheck = false;
-                } else if (word.size() < 21) {
-                    word += num;
                 }
             } else {
-                if (shouldCheck && word.size() > 20) {
-                    word.pop_back();
-                    outFile << "Long word at line " << to_string(line_number)
-                            << ", starts: " << word << "\n";
-                } else if (shouldCheck && word.size() > 0 && !(table.contains(word))) {
-                    outFile << "Unknown word at line " << to_string(line_number) << ": "
-                            << word << "\n";
+                if (shouldCheck) {
+                    add_word(string_view(line + start, i - start));
                 }
                 shouldCheck = true;
-                word = "";
+                start = i + 1;
             }
         }
     // Handling words that might've been missed at the end of the string
-        if (shouldCheck && word.size() > 20) {
-            word.pop_back();
-            outFile << "Long word at line " << to_string(line_number)
-                    << ", starts: " << word << "\n";
-        } else if (shouldCheck && word.size() > 0 and !(table.contains(word))) {
-            outFile << "Unknown word at line " << to_string(line_number) << ": "
-                    << word << "\n";
+        if (shouldCheck) {
+            add_word(string_view(line + start, read_line.size() - start));
         }
+        // Look up whatever is left before the line buffer is reused
+        flush();
     }
 }
 
-int main() {
+// Time the spellcheck of one file against a loaded dictionary
+template <typename Dict>
+void run_spellcheck(string spellcheck_name, string output, Dict& table) {
+    clock_t t1 = clock();
+    spellcheck(spellcheck_name, output, table);
+    clock_t t2 = clock();
+    double timeDiff = ((double)(t2 - t1)) / CLOCKS_PER_SEC;
+    cout << "Spellcheck Complete. CPU time was " << timeDiff << " seconds.\n";
+}
+
+// Looks words up in whichever dictionary version is current when
+// a batch starts, so a reload takes effect from the next line on
+class liveDictionary {
+public:
+    explicit liveDictionary(const rcu<dictionary> &versions) : versions(versions) {}
+    void containsBatch(const string_view *words, size_t count, bool *found) const {
+        auto snapshot = versions.read();
+        snapshot->containsBatch(words, count, found);
+    }
+private:
+    const rcu<dictionary> &versions;
+};
+
+// Modification time and size of a file, to notice when it changes
+pair<time_t, off_t> file_version(const string &filename) {
+    struct stat st;
+    if (stat(filename.c_str(), &st) != 0) {
+        return {0, 0};
+    }
+    return {st.st_mtime, st.st_size};
+}
+
+// Parse the dictionary again and publish it whenever its file
+// changes, until stop is set; checks in progress are not paused
+void watch_dictionary(string dict_name, bool use_filter, rcu<dictionary> &versions,
+                      atomic<bool> &stop) {
+    pair<time_t, off_t> last = file_version(dict_name);
+    while (!stop) {
+        this_thread::sleep_for(chrono::milliseconds(500));
+        pair<time_t, off_t> now = file_version(dict_name);
+        if (now == last) {
+            continue;
+        }
+        last = now;
+        try {
+            versions.publish(load_dictionary(dict_name, use_filter));
+            cout << "\nDictionary reloaded.\n";
+        } catch (const invalid_argument &) {
+            // Keep checking against the current version
+        }
+    }
+}
+
+// Print the statistics of a dictionary's table and filter
+void print_stats(const dictionary &dict) {
+#if defined(USE_SWISS) || defined(USE_CONCURRENT)
+    cout << "Table statistics are only kept by hashTable.\n";
+#else
+    cout << "\nDictionary table statistics:\n";
+    dict.table->getStats().print(cout);
+#endif
+    if (dict.filter != nullptr) {
+        cout << "Filter: " << dict.filter->bytes() << " bytes\n";
+    }
+}
+
+// Check files one after another against a dictionary that is
+// reloaded in the background, until the user enters "quit";
+// then print the statistics of the version current at that point
+// if show_stats is set
+void serve_with_reload(string dict_name, dictionary *dict, string spellcheck_name, string output,
+                       bool show_stats) {
+    rcu<dictionary> versions(dict);
+    liveDictionary live(versions);
+    atomic<bool> stop(false);
+    thread watcher(watch_dictionary, dict_name, dict->filter != nullptr,
+                   ref(versions), ref(stop));
+    while (true) {
+        run_spellcheck(spellcheck_name, output, live);
+        cout << "\nEnter name of file to spellcheck (quit to stop): ";
+        if (!(cin >> spellcheck_name) || spellcheck_name == "quit") {
+            break;
+        }
+        cout << "\nEnter output file: ";
+        if (!(cin >> output)) {
+            break;
+        }
+    }
+    stop = true;
+    watcher.join();
+
+    if (show_stats) {
+        print_stats(*versions.read());
+    }
+}
+
+// Usage:
+//   spell.exe                              check a file (prompts for names)
+//   spell.exe --compile <words> <out>      compile a word list into a
+//                                          dictionary file that spell.exe
+//                                          can load instead of the list
+//   spell.exe --stats                      check a file, then print the
+//                                          dictionary table's statistics
+//                                          (with --reload, once the user
+//                                          quits)
+//   spell.exe --reload                     keep checking files, reloading
+//                                          the dictionary when it changes
+//   spell.exe --filter                     put a Bloom filter in front of
+//                                          the dictionary table
+// --stats, --reload and --filter may be combined; none of them
+// applies to a compiled dictionary.
+int main(int argc, char **argv) {
+    if (argc == 4 && string(argv[1]) == "--compile") {
+        clock_t t1 = clock();
+        if (!perfectHash::write(read_dictionary(argv[2]), argv[3])) {
+            cerr << "Error: could not write " << argv[3] << "\n";
+            return 1;
+        }
+        clock_t t2 = clock();
+        double timeDiff = ((double)(t2 - t1)) / CLOCKS_PER_SEC;
+        cout << "Dictionary compiled. CPU time was " << timeDiff << " seconds.\n";
+        return 0;
+    }
+    bool show_stats = false;
+    bool reload = false;
+    bool use_filter = false;
+    for (int i = 1; i < argc; i++) {
+        string option = argv[i];
+        if (option == "--stats") {
+            show_stats = true;
+        } else if (option == "--reload") {
+            reload = true;
+        } else if (option == "--filter") {
+            use_filter = true;
+        } else {
+            cerr << "Error: unknown option " << option << "\n";
+            return 1;
+        }
+    }
+
     string dict_name; // = "wordlist_small.txt";
     cout << "Enter dictionary file: ";
     cin >> dict_name;
@@ -103,17 +407,38 @@ int main() {
     string output; // = "output.txt";
     cout << "\nEnter output file: ";
     cin >> output;
+
+    // A compiled dictionary is mapped and used as is
+    if (perfectHash::isDictionaryFile(dict_name)) {
+        cout << "Loading Compiled Dictionary.\n";
+        clock_t t1 = clock();
+        perfectHash dict;
+        if (!dict.load(dict_name)) {
+            cerr << "Error: " << dict_name << " is not a valid dictionary file\n";
+            return 1;
+        }
+        clock_t t2 = clock();
+        double timeDiff = ((double)(t2 - t1)) / CLOCKS_PER_SEC;
+        cout << "Dictionary Loaded. CPU time was " << timeDiff << " seconds.\n";
+        run_spellcheck(spellcheck_name, output, dict);
+        return 0;
+    }
+
     cout << "Parsing Dictionary.\n";
     clock_t t1 = clock();
-    hashTable* table = parse_dictionary(dict_name);
+    dictionary* dict = load_dictionary(dict_name, use_filter);
     clock_t t2 = clock();
     double timeDiff = ((double)(t2 - t1)) / CLOCKS_PER_SEC;
     cout << "Hashmap Loaded. CPU time was " << timeDiff << " seconds.\n";
-    t1 = clock();
-    spellcheck(spellcheck_name, output, *table);
-    t2 = clock();
-    timeDiff = ((double)(t2 - t1)) / CLOCKS_PER_SEC;
-    cout << "Spellcheck Complete. CPU time was " << timeDiff << " seconds.\n";
+    if (reload) {
+        serve_with_reload(dict_name, dict, spellcheck_name, output, show_stats);
+        return 0;
+    }
+    run_spellcheck(spellcheck_name, output, *dict);
+
+    if (show_stats) {
+        print_stats(*dict);
+    }
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,254 @@
+#include <vector>
+#include <string>
+#include <new>
+#include <algorithm>
+#include "swisstable.h"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+using namespace std;
+
+// Constructor
+swissTable::swissTable(int size) {
+    capacity = getCapacity(size > 0 ? size : 0);
+    filled = 0;
+    deleted = 0;
+    ctrl.assign(capacity + groupWidth, ctrlEmpty);
+    slots.resize(capacity);
+}
+
+// Insert function
+int swissTable::insert(std::string_view key, void *pv) {
+    size_t h = hash(key);
+    if (findPos(key, h) != -1) {
+        return 1;
+    }
+
+    // Keep the load (tombstones included) at or below 7/8.
+    // If tombstones make up a large part of it, rebuild at the
+    // same size to reclaim them; otherwise double the table.
+    if ((filled + deleted + 1) * 8 > capacity * 7) {
+        size_t newCapacity = capacity;
+        if ((filled + 1) * 16 > capacity * 7) {
+            newCapacity = capacity * 2;
+        }
+        if (!rehash(newCapacity)) {
+            return 2;
+        }
+    }
+
+    size_t pos = findFree(h);
+    if (ctrl[pos] == ctrlDeleted) {
+        deleted--;
+    }
+    setCtrl(pos, h2(h));
+    slots[pos].key = key;
+    slots[pos].pv = pv;
+    filled++;
+
+    return 0;
+}
+
+// Contains function
+bool swissTable::contains(std::string_view key) const {
+    return findPos(key, hash(key)) != -1;
+}
+
+// Get pointer function
+void *swissTable::getPointer(std::string_view key, bool *b) const {
+    long pos = findPos(key, hash(key));
+    if (b != nullptr) {
+        *b = (pos != -1);
+    }
+    return pos != -1 ? slots[pos].pv : nullptr;
+}
+
+// Set pointer function
+int swissTable::setPointer(std::string_view key, void *pv) {
+    long pos = findPos(key, hash(key));
+    if (pos != -1) {
+        slots[pos].pv = pv;
+        return 0;
+    }
+    return 1;
+}
+
+// Contains batch function
+void swissTable::containsBatch(const std::string_view *keys, size_t count, bool *found) const {
+    long positions[batchGroup];
+    for (size_t i = 0; i < count; i += batchGroup) {
+        size_t n = min<size_t>(batchGroup, count - i);
+        findBatch(keys + i, n, positions);
+        for (size_t j = 0; j < n; j++) {
+            found[i + j] = (positions[j] != -1);
+        }
+    }
+}
+
+// Get pointer batch function
+void swissTable::getPointerBatch(const std::string_view *keys, size_t count, void **pointers) const {
+    long positions[batchGroup];
+    for (size_t i = 0; i < count; i += batchGroup) {
+        size_t n = min<size_t>(batchGroup, count - i);
+        findBatch(keys + i, n, positions);
+        for (size_t j = 0; j < n; j++) {
+            pointers[i + j] = positions[j] != -1 ? slots[positions[j]].pv : nullptr;
+        }
+    }
+}
+
+// Find batch function
+void swissTable::findBatch(const std::string_view *keys, size_t count, long *positions) const {
+    size_t hashes[batchGroup];
+    for (size_t i = 0; i < count; i++) {
+        hashes[i] = hash(keys[i]);
+        size_t pos = h1(hashes[i]) & (capacity - 1);
+        __builtin_prefetch(&ctrl[pos]);
+        __builtin_prefetch(&slots[pos]);
+    }
+    for (size_t i = 0; i < count; i++) {
+        positions[i] = findPos(keys[i], hashes[i]);
+    }
+}
+
+// Remove function
+bool swissTable::remove(std::string_view key) {
+    long pos = findPos(key, hash(key));
+    if (pos == -1) {
+        return false;
+    }
+    setCtrl(pos, ctrlDeleted);
+    slots[pos].key = string();
+    slots[pos].pv = nullptr;
+    filled--;
+    deleted++;
+    return true;
+}
+
+// Hash function
+size_t swissTable::hash(std::string_view key) {
+    std::hash<std::string_view> hasher;
+    return hasher(key);
+}
+
+// Match a control byte value across one group
+uint32_t swissTable::matchByte(size_t pos, int8_t value) const {
+#if defined(__SSE2__)
+    __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&ctrl[pos]));
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(value)));
+#else
+    uint32_t mask = 0;
+    for (size_t i = 0; i < groupWidth; i++) {
+        if (ctrl[pos + i] == value) {
+            mask |= 1u << i;
+        }
+    }
+    return mask;
+#endif
+}
+
+// Match empty slots across one group
+uint32_t swissTable::matchEmpty(size_t pos) const {
+    return matchByte(pos, ctrlEmpty);
+}
+
+// Match empty or deleted slots (high bit set) across one group
+uint32_t swissTable::matchEmptyOrDeleted(size_t pos) const {
+#if defined(__SSE2__)
+    __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&ctrl[pos]));
+    return _mm_movemask_epi8(group);
+#else
+    uint32_t mask = 0;
+    for (size_t i = 0; i < groupWidth; i++) {
+        if (ctrl[pos + i] < 0) {
+            mask |= 1u << i;
+        }
+    }
+    return mask;
+#endif
+}
+
+// Set control byte function
+void swissTable::setCtrl(size_t pos, int8_t value) {
+    ctrl[pos] = value;
+    if (pos < groupWidth) {
+        ctrl[capacity + pos] = value;
+    }
+}
+
+// Find position function
+// Groups are visited with a triangular stride, which reaches every
+// group of a power of two table; the search ends at the first group
+// that still has an empty slot, since insert would have used it.
+long swissTable::findPos(std::string_view key, size_t h) const {
+    size_t mask = capacity - 1;
+    size_t pos = h1(h) & mask;
+    int8_t tag = h2(h);
+
+    for (size_t step = groupWidth; ; step += groupWidth) {
+        uint32_t match = matchByte(pos, tag);
+        while (match != 0) {
+            size_t i = (pos + __builtin_ctz(match)) & mask;
+            if (slots[i].key == key) {
+                return i;
+            }
+            match &= match - 1;
+        }
+        if (matchEmpty(pos) != 0) {
+            return -1;
+        }
+        pos = (pos + step) & mask;
+    }
+}
+
+// Find free slot function
+size_t swissTable::findFree(size_t h) {
+    size_t mask = capacity - 1;
+    size_t pos = h1(h) & mask;
+
+    for (size_t step = groupWidth; ; step += groupWidth) {
+        uint32_t match = matchEmptyOrDeleted(pos);
+        if (match != 0) {
+            return (pos + __builtin_ctz(match)) & mask;
+        }
+        pos = (pos + step) & mask;
+    }
+}
+
+// Rehash function
+bool swissTable::rehash(size_t newCapacity) {
+    vector<int8_t> oldCtrl;
+    vector<slot> oldSlots;
+    try {
+        oldCtrl.assign(newCapacity + groupWidth, ctrlEmpty);
+        oldSlots.resize(newCapacity);
+    } catch (const bad_alloc &) {
+        return false;
+    }
+    oldCtrl.swap(ctrl);
+    oldSlots.swap(slots);
+    size_t oldCapacity = capacity;
+
+    capacity = newCapacity;
+    deleted = 0;
+
+    // Move every live item into the new arrays
+    for (size_t i = 0; i < oldCapacity; i++) {
+        if (oldCtrl[i] >= 0) {
+            size_t h = hash(oldSlots[i].key);
+            size_t pos = findFree(h);
+            setCtrl(pos, h2(h));
+            slots[pos] = std::move(oldSlots[i]);
+        }
+    }
+    return true;
+}
+
+// Get capacity function
+size_t swissTable::getCapacity(size_t size) {
+    size_t capacity = groupWidth;
+    while (size * 8 > capacity * 7) {
+        capacity <<= 1;
+    }
+    return capacity;
+}
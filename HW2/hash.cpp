@@ -3,59 +3,79 @@
 #include <string>
 #include <stdexcept> 
 #include <limits>
+#include <new>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
 #include "hash.h"
 using namespace std;
 
 // Constructor
-hashTable::hashTable(int size) {
-    capacity = getPrime(size);
+hashTable::hashMap(int size, int flags) {
+    capacity = getCapacity(size);
+    shift = getShift(capacity);
     filled = 0;
+    tombstones = 0;
+    deadBytes = 0;
+    this->flags = flags;
+    oldCapacity = 0;
+    oldShift = 0;
+    migrated = 0;
     data.resize(capacity);
 }
 
 // Insert function
-int hashTable::insert(const std::string &key, void *pv) {
+int hashTable::insert(std::string_view key, void *pv) {
     
-    if (contains(key)) {
+    if (oldCapacity) {
+        migrate(migrateStep);
+    }
+
+    size_t h = hash(key);
+    if (findPos(key, h) != -1 || findOldPos(key, h) != -1) {
         return 1;
     }
     
-    // Check if rehash is needed
-    if (filled >= capacity / 2) {
-        if (!rehash()) {
+    // Check if rehash is needed; tombstones count towards the load
+    // since they lengthen probe chains just like live items.
+    // If most of the load is tombstones, or most of the key arena
+    // is removed keys, purge them in place instead of growing.
+    bool crowded = filled + tombstones >= capacity / 2;
+    bool wasteful = deadBytes > 4096 && deadBytes * 2 > keys.size();
+    if (crowded || wasteful) {
+        if (oldCapacity) {
+            migrate(oldCapacity);
+        }
+        int newCapacity = (crowded && tombstones < filled) ? capacity * 2 : capacity;
+        bool ok = (flags & INCREMENTAL) ? startMigration(newCapacity)
+                                        : rehash(newCapacity);
+        if (!ok) {
             return 2; 
         }
     }
     
-    // Find position using linear probing
-    int pos = hash(key);
-    while (data[pos].isOccupied && !data[pos].isDeleted) {
-        pos = (pos + 1) % capacity;
-    }
-    
     // Insert the item
-    data[pos].key = key;
-    data[pos].isOccupied = true;
-    data[pos].isDeleted = false;
-    data[pos].pv = pv;
+    if (!addItem(key, h, pv)) {
+        return 2;
+    }
     filled++;
     
     return 0; 
 }
 
 // Contains function
-bool hashTable::contains(const std::string &key) {
-    return findPos(key) != -1;
+bool hashTable::contains(std::string_view key) const {
+    return findItem(key) != nullptr;
 }
 
 // Get pointer function
-void *hashTable::getPointer(const std::string &key, bool *b) {
-    int pos = findPos(key);
-    if (pos != -1) {
+void *hashTable::getPointer(std::string_view key, bool *b) const {
+    const hashItem *item = findItem(key);
+    if (item != nullptr) {
         if (b != nullptr) {
             *b = true;
         }
-        return data[pos].pv;
+        return item->pv;
     } else {
         if (b != nullptr) {
             *b = false;
@@ -65,94 +85,378 @@ void *hashTable::getPointer(const std::string &key, bool *b) {
 }
 
 // Set pointer function
-int hashTable::setPointer(const std::string &key, void *pv) {
-    int pos = findPos(key);
+int hashTable::setPointer(std::string_view key, void *pv) {
+    size_t h = hash(key);
+    int pos = findPos(key, h);
     if (pos != -1) {
         data[pos].pv = pv;
         return 0; 
     }
+    pos = findOldPos(key, h);
+    if (pos != -1) {
+        oldData[pos].pv = pv;
+        return 0; 
+    }
     return 1; 
 }
 
+// Contains batch function
+void hashTable::containsBatch(const std::string_view *keys, size_t count, bool *found) const {
+    const hashItem *items[batchGroup];
+    for (size_t i = 0; i < count; i += batchGroup) {
+        size_t n = min<size_t>(batchGroup, count - i);
+        findBatch(keys + i, n, items);
+        for (size_t j = 0; j < n; j++) {
+            found[i + j] = (items[j] != nullptr);
+        }
+    }
+}
+
+// Get pointer batch function
+void hashTable::getPointerBatch(const std::string_view *keys, size_t count, void **pointers) const {
+    const hashItem *items[batchGroup];
+    for (size_t i = 0; i < count; i += batchGroup) {
+        size_t n = min<size_t>(batchGroup, count - i);
+        findBatch(keys + i, n, items);
+        for (size_t j = 0; j < n; j++) {
+            pointers[i + j] = items[j] != nullptr ? items[j]->pv : nullptr;
+        }
+    }
+}
+
+// Find batch function
+void hashTable::findBatch(const std::string_view *keys, size_t count, const hashItem **items) const {
+    size_t hashes[batchGroup];
+    for (size_t i = 0; i < count; i++) {
+        hashes[i] = hash(keys[i]);
+        __builtin_prefetch(&data[slot(hashes[i], shift)]);
+    }
+    for (size_t i = 0; i < count; i++) {
+        items[i] = findItem(keys[i], hashes[i]);
+    }
+}
+
 // Remove function
-bool hashTable::remove(const std::string &key) {
-    int pos = findPos(key);
-    if (pos != -1) {
-        data[pos].isDeleted = true;
+bool hashTable::remove(std::string_view key) {
+    if (oldCapacity) {
+        migrate(migrateStep);
+    }
+
+    size_t h = hash(key);
+    int pos = findPos(key, h);
+    if (pos == -1) {
+        // Items still waiting in oldData are always just marked
+        // deleted, so the migration scan cannot skip over them
+        pos = findOldPos(key, h);
+        if (pos == -1) {
+            return false;
+        }
+        oldData[pos].isDeleted = true;
+        filled--;
         return true;
     }
-    return false; 
+    filled--;
+    deadBytes += data[pos].keyLength;
+    if (flags & BACKSHIFT) {
+        shiftBack(pos);
+    } else {
+        data[pos].isDeleted = true;
+        tombstones++;
+    }
+    return true;
 }
 
 // Hash function
-int hashTable::hash(const std::string &key) {
-    std::hash<std::string> hasher;
-    return hasher(key) % capacity;
+size_t hashTable::hash(std::string_view key) {
+    std::hash<std::string_view> hasher;
+    return hasher(key);
 }
 
 // Find position function
-int hashTable::findPos(const std::string &key) {
-    int pos = hash(key);
+int hashTable::findPos(std::string_view key, size_t h) const {
+    return probe(data, shift, keys, key, h);
+}
+
+// Find old position function
+int hashTable::findOldPos(std::string_view key, size_t h) const {
+    if (!oldCapacity) {
+        return -1;
+    }
+    return probe(oldData, oldShift, oldKeys, key, h);
+}
+
+// Probe function
+int hashTable::probe(const std::vector<hashItem> &table, int shift,
+                     const std::vector<char> &arena, std::string_view key, size_t h) const {
+    int size = table.size();
+    int mask = size - 1;
+    int pos = slot(h, shift);
+    int found = -1;
+    int probes = 0;
     
-    while (data[pos].isOccupied) {
-        if (!data[pos].isDeleted && data[pos].key == key) {
-            return pos;
-        }
-        pos = (pos + 1) % capacity;
-        
-        if (pos == hash(key)) {
+    // The load limit guarantees an empty slot ends every chain,
+    // so tombstones are skipped rather than ending the search.
+    // The key bytes are only read when the full hashes match.
+    for (; probes < size && table[pos].isOccupied; probes++) {
+        const hashItem &item = table[pos];
+        if (item.hash == h && !item.isDeleted && item.keyLength == key.size()
+            && memcmp(arena.data() + item.keyOffset, key.data(), key.size()) == 0) {
+            found = pos;
+            probes++;
             break;
         }
+        pos = (pos + 1) & mask;
+    }
+
+#ifdef HASH_STATS
+    lookupCount++;
+    probeCount += probes;
+#endif
+    return found; 
+}
+
+// Find item function
+const hashTable::hashItem *hashTable::findItem(std::string_view key) const {
+    return findItem(key, hash(key));
+}
+
+const hashTable::hashItem *hashTable::findItem(std::string_view key, size_t h) const {
+    int pos = findPos(key, h);
+    if (pos != -1) {
+        return &data[pos];
     }
+    pos = findOldPos(key, h);
+    if (pos != -1) {
+        return &oldData[pos];
+    }
+    return nullptr;
+}
+
+// Add item function
+bool hashTable::addItem(std::string_view key, size_t h, void *pv) {
+    if (keys.size() + key.size() > numeric_limits<uint32_t>::max()) {
+        return false;
+    }
+    hashItem item;
+    item.hash = h;
+    item.keyOffset = keys.size();
+    item.keyLength = key.size();
+    item.isOccupied = true;
+    item.pv = pv;
+    keys.insert(keys.end(), key.begin(), key.end());
+    placeItem(item);
+    return true;
+}
+
+// Place item function
+void hashTable::placeItem(const hashItem &item) {
+    // Find position using linear probing; reuse the first
+    // tombstone on the chain if there is one
+    int mask = capacity - 1;
+    int pos = slot(item.hash, shift);
+    while (data[pos].isOccupied && !data[pos].isDeleted) {
+        pos = (pos + 1) & mask;
+    }
+    if (data[pos].isDeleted) {
+        tombstones--;
+    }
+    data[pos] = item;
+}
+
+// Backward shift deletion
+void hashTable::shiftBack(int pos) {
+    data[pos] = hashItem();
+    int mask = capacity - 1;
+    int next = (pos + 1) & mask;
     
-    return -1; 
+    while (data[next].isOccupied) {
+        // An item may move into the hole only if the hole lies
+        // between its home slot and its current slot
+        int home = slot(data[next].hash, shift);
+        int dist = (next - home) & mask;
+        int gap = (next - pos) & mask;
+        if (dist >= gap) {
+            data[pos] = data[next];
+            data[next] = hashItem();
+            pos = next;
+        }
+        next = (next + 1) & mask;
+    }
 }
 
 // Rehash function
-bool hashTable::rehash() {
-    // Save old data
-    std::vector<hashItem> oldData = data;
-    int oldCapacity = capacity;
-    
-    // Create new, larger table
-    capacity = getPrime(capacity * 2);
-    filled = 0;
-    data.clear();
-    data.resize(capacity);
+bool hashTable::rehash(int newCapacity) {
+    // Allocate the new table and arena first so a failure
+    // leaves the current ones untouched
+    std::vector<hashItem> oldItems;
+    std::vector<char> oldArena;
+    try {
+        oldItems.resize(newCapacity);
+        oldArena.reserve(keys.size() - deadBytes);
+    } catch (const std::bad_alloc &) {
+        return false;
+    }
+#ifdef HASH_STATS
+    auto start = chrono::steady_clock::now();
+#endif
+    data.swap(oldItems);
+    keys.swap(oldArena);
+    int oldSize = capacity;
+    capacity = newCapacity;
+    shift = getShift(capacity);
+    tombstones = 0;
+    deadBytes = 0;
     
-    // Reinsert all non-deleted items
-    for (int i = 0; i < oldCapacity; i++) {
-        if (oldData[i].isOccupied && !oldData[i].isDeleted) {
-            if (insert(oldData[i].key, oldData[i].pv) != 0) {
-                data = oldData;
-                capacity = oldCapacity;
-                filled = 0;
-                for (int j = 0; j < capacity; j++) {
-                    if (data[j].isOccupied && !data[j].isDeleted) {
-                        filled++;
-                    }
-                }
-                return false;
-            }
+    // Copy all non-deleted items and their keys across;
+    // the cached hashes mean no key is hashed again
+    for (int i = 0; i < oldSize; i++) {
+        hashItem item = oldItems[i];
+        if (item.isOccupied && !item.isDeleted) {
+            const char *key = oldArena.data() + item.keyOffset;
+            item.keyOffset = keys.size();
+            keys.insert(keys.end(), key, key + item.keyLength);
+            placeItem(item);
         }
     }
+#ifdef HASH_STATS
+    rehashCount++;
+    rehashTime += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+#endif
     return true;
 }
 
-// Get prime function
-unsigned int hashTable::getPrime(int size) {
-    // Prime numbers
-    static const unsigned int primes[] = {
-        6291469, 12582917, 25165843, 50331653, 100663319,
-        201326611, 402653189, 805306457, 1610612741,3221225533
-    };
-    
-    const int numPrimes = sizeof(primes) / sizeof(primes[0]);
-    
-    for (int i = 0; i < numPrimes; i++) {
-        if (primes[i] >= size) {
-            return primes[i];
+// Start migration function
+bool hashTable::startMigration(int newCapacity) {
+    std::vector<hashItem> newData;
+    std::vector<char> newKeys;
+    try {
+        newData.resize(newCapacity);
+        newKeys.reserve(keys.size() - deadBytes);
+    } catch (const std::bad_alloc &) {
+        return false;
+    }
+    oldData = std::move(data);
+    oldKeys = std::move(keys);
+    oldCapacity = capacity;
+    oldShift = shift;
+    migrated = 0;
+    data = std::move(newData);
+    keys = std::move(newKeys);
+    capacity = newCapacity;
+    shift = getShift(capacity);
+    tombstones = 0;
+    deadBytes = 0;
+#ifdef HASH_STATS
+    rehashCount++;
+#endif
+    return true;
+}
+
+// Migrate function
+void hashTable::migrate(int count) {
+#ifdef HASH_STATS
+    auto start = chrono::steady_clock::now();
+#endif
+    for (; count > 0 && migrated < oldCapacity; count--, migrated++) {
+        hashItem item = oldData[migrated];
+        if (item.isOccupied && !item.isDeleted) {
+            const char *key = oldKeys.data() + item.keyOffset;
+            item.keyOffset = keys.size();
+            keys.insert(keys.end(), key, key + item.keyLength);
+            placeItem(item);
+            oldData[migrated].isDeleted = true;
+        }
+    }
+    if (migrated == oldCapacity) {
+        std::vector<hashItem>().swap(oldData);
+        std::vector<char>().swap(oldKeys);
+        oldCapacity = 0;
+        migrated = 0;
+    }
+#ifdef HASH_STATS
+    rehashTime += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+#endif
+}
+
+// Get stats function
+hashTable::stats hashTable::getStats() const {
+    stats result;
+    result.capacity = capacity;
+    result.filled = filled;
+    result.tombstones = tombstones;
+    result.loadFactor = double(filled + tombstones) / capacity;
+    result.probeHistogram.assign(histogramSize, 0);
+    result.keyBytes = keys.size();
+    result.deadBytes = deadBytes;
+    result.migrating = (oldCapacity != 0);
+
+    // An item's probe length is its distance from its home slot plus one
+    int mask = capacity - 1;
+    size_t live = 0;
+    size_t totalProbe = 0;
+    for (int pos = 0; pos < capacity; pos++) {
+        const hashItem &item = data[pos];
+        if (item.isOccupied && !item.isDeleted) {
+            size_t length = ((pos - slot(item.hash, shift)) & mask) + 1;
+            live++;
+            totalProbe += length;
+            result.maxProbe = max(result.maxProbe, length);
+            result.probeHistogram[min<size_t>(length, histogramSize) - 1]++;
+        }
+    }
+    result.averageProbe = live ? double(totalProbe) / live : 0;
+
+#ifdef HASH_STATS
+    result.lookups = lookupCount;
+    result.lookupProbes = probeCount;
+    result.rehashes = rehashCount;
+    result.rehashSeconds = rehashTime;
+#endif
+    return result;
+}
+
+// Print stats function
+void hashTable::stats::print(ostream &out) const {
+    out << "Capacity: " << capacity << "\n";
+    out << "Items: " << filled << "\n";
+    out << "Tombstones: " << tombstones << "\n";
+    out << "Load factor: " << loadFactor << "\n";
+    out << "Key arena: " << keyBytes << " bytes (" << deadBytes << " dead)\n";
+    if (migrating) {
+        out << "Resize in progress\n";
+    }
+    out << "Average probe length: " << averageProbe << "\n";
+    out << "Max probe length: " << maxProbe << "\n";
+    out << "Probe length histogram:\n";
+    for (size_t i = 0; i < probeHistogram.size(); i++) {
+        if (probeHistogram[i] != 0) {
+            out << "  " << i + 1 << (i + 1 == probeHistogram.size() ? "+" : "")
+                << ": " << probeHistogram[i] << "\n";
         }
     }
-    return primes[numPrimes - 1];
-}
\ No newline at end of file
+#ifdef HASH_STATS
+    out << "Lookups: " << lookups << " (" << lookupProbes << " occupied slots read)\n";
+    out << "Rehashes: " << rehashes << " (" << rehashSeconds << " seconds)\n";
+#else
+    out << "Build with -DHASH_STATS for lookup and rehash counters.\n";
+#endif
+}
+
+// Get capacity function
+int hashTable::getCapacity(int size) {
+    int capacity = 16;
+    while (capacity / 2 < size && capacity < (1 << 30)) {
+        capacity <<= 1;
+    }
+    return capacity;
+}
+
+// Get shift function
+int hashTable::getShift(int capacity) {
+    int shift = 64;
+    while (capacity > 1) {
+        capacity >>= 1;
+        shift--;
+    }
+    return shift;
+}
@@ -1,134 +1,678 @@
 #include "heap.h"
+#include <algorithm>
 #include <cstddef>
+#include <new>
 #include <string>
-#include <vector> 
+#include <vector>
 
-void heap::percolate_down(std::size_t pos)
+template <int D>
+void indexHeap<D>::percolate_down(std::size_t pos, entry_t e)
 {
-    nodes[0] = nodes[pos];
-    auto posCur = pos;
+    std::size_t end = last();
 
-    while (pos << 1 <= use) {
-        pos <<= 1;
+    while (firstChild(pos) <= end) {
+        // Pick the smallest of the (up to D) children
+        std::size_t child = firstChild(pos);
+        std::size_t groupEnd = std::min(child + D - 1, end);
+        for (std::size_t c = child + 1; c <= groupEnd; ++c) {
+            if (entries[c].key < entries[child].key) child = c;
+        }
 
-        if ((pos < use) && nodes[pos + 1].key < nodes[pos].key) ++pos;
+        if (e.key > entries[child].key) {
+            place(pos, entries[child]);
+        } else break;
+
+        pos = child;
+    }
+
+    place(pos, e);
+}
+
+template <int D>
+void indexHeap<D>::percolate_up(std::size_t pos, entry_t e)
+{
+    while (pos > root) {
+        std::size_t up = parent(pos);
 
-        if (nodes[0].key > nodes[pos].key) {
-            nodes[posCur] = nodes[pos];
-            map->setPointer(nodes[posCur].id, &nodes[posCur]);
+        if (e.key < entries[up].key) {
+            place(pos, entries[up]);
         } else break;
 
-        posCur = pos;
+        pos = up;
+    }
+
+    place(pos, e);
+}
+
+template <int D>
+indexHeap<D>::indexHeap(std::size_t capacity)
+{
+    entries.resize(capacity + D - 1);
+    where.assign(capacity, absent);
+    use = 0;
+}
+
+template <int D>
+bool indexHeap<D>::grow(std::size_t handle, std::size_t count)
+{
+    try {
+        if (handle >= where.size()) {
+            where.resize(std::max(handle + 1, where.size() * 2), absent);
+        }
+        std::size_t capacity = entries.size() - (D - 1);
+        if (use + count > capacity) {
+            std::size_t newCapacity = std::max<std::size_t>(16, capacity * 2);
+            entries.resize(std::max(newCapacity, use + count) + D - 1);
+        }
+    } catch (const std::bad_alloc &) {
+        return false;
+    }
+    return true;
+}
+
+template <int D>
+void indexHeap<D>::heapify()
+{
+    if (use < 2) return;
+
+    // Every position past the last parent is a leaf; sift the
+    // parents down, deepest first
+    for (std::size_t pos = parent(last()) + 1; pos-- > root; ) {
+        percolate_down(pos, entries[pos]);
+    }
+}
+
+template <int D>
+bool indexHeap<D>::rebuildCheaper(std::size_t count, std::size_t size) const
+{
+    // Moving one entry costs up to one step per level; a rebuild
+    // costs about one step per entry
+    std::size_t depth = 0;
+    for (std::size_t n = size; n > 0; n /= D) {
+        depth++;
+    }
+    return count * depth > size;
+}
+
+template <int D>
+int indexHeap<D>::insert(std::size_t handle, int key)
+{
+    if (handle > UINT32_MAX) return 1;
+    if (contains(handle)) return 2;
+    if (!grow(handle)) return 1;
+
+    ++use;
+    percolate_up(last(), entry_t{key, static_cast<std::uint32_t>(handle)});
+    return 0;
+}
+
+template <int D>
+int indexHeap<D>::insertAll(const item_t *items, std::size_t count)
+{
+    std::size_t maxHandle = 0;
+    for (std::size_t i = 0; i < count; ++i) {
+        if (items[i].handle > UINT32_MAX) return 1;
+        maxHandle = std::max(maxHandle, items[i].handle);
+    }
+    if (!grow(maxHandle, count)) return 1;
+
+    bool rebuild = rebuildCheaper(count, use + count);
+    int result = 0;
+    for (std::size_t i = 0; i < count; ++i) {
+        if (contains(items[i].handle)) {
+            result = 2;
+            continue;
+        }
+        entry_t e{items[i].key, static_cast<std::uint32_t>(items[i].handle)};
+        ++use;
+        if (rebuild)
+            place(last(), e);
+        else
+            percolate_up(last(), e);
+    }
+    if (rebuild) {
+        heapify();
+    }
+    return result;
+}
+
+template <int D>
+int indexHeap<D>::setKey(std::size_t handle, int key)
+{
+    if (!contains(handle)) return 1;
+
+    std::size_t pos = where[handle];
+    entry_t e = entries[pos];
+    int oldKey = e.key;
+    e.key = key;
+
+    if (key < oldKey)
+        percolate_up(pos, e);
+    else
+        percolate_down(pos, e);
+    return 0;
+}
+
+template <int D>
+int indexHeap<D>::setKeys(const item_t *items, std::size_t count)
+{
+    int result = 0;
+    // The entries are already in the heap, so its size is unchanged
+    if (!rebuildCheaper(count, use)) {
+        for (std::size_t i = 0; i < count; ++i) {
+            if (setKey(items[i].handle, items[i].key) != 0) result = 1;
+        }
+        return result;
+    }
+
+    for (std::size_t i = 0; i < count; ++i) {
+        if (!contains(items[i].handle)) {
+            result = 1;
+            continue;
+        }
+        entries[where[items[i].handle]].key = items[i].key;
     }
+    heapify();
+    return result;
+}
 
-    nodes[posCur] = nodes[0];
-    map->setPointer(nodes[posCur].id, &nodes[posCur]);
+template <int D>
+int indexHeap<D>::deleteMin(std::size_t *handle, int *key)
+{
+    if (!use) return 1;
+
+    if (handle) *handle = entries[root].handle;
+    if (key)    *key    = entries[root].key;
+
+    where[entries[root].handle] = absent;
+    entry_t moved = entries[last()];
+    use--;
+    if (use > 0) {
+        percolate_down(root, moved);
+    }
+    return 0;
 }
 
-void heap::percolate_up(std::size_t pos)
+template <int D>
+int indexHeap<D>::remove(std::size_t handle, int *key)
 {
-    nodes[0] = nodes[pos];
-    auto posCur = pos;
+    if (!contains(handle)) return 1;
+
+    std::size_t pos = where[handle];
+    if (key) *key = entries[pos].key;
 
-    while (pos >> 1 > 0) {
-        pos >>= 1;
+    std::size_t end = last();
+    entry_t moved = entries[end];
+    where[handle] = absent;
+    use--;
+    if (pos != end) {
+        if ((pos > root) && (moved.key < entries[parent(pos)].key))
+            percolate_up(pos, moved);
+        else
+            percolate_down(pos, moved);
+    }
+    return 0;
+}
 
-        if (nodes[0].key < nodes[pos].key) {
-            nodes[posCur] = nodes[pos];
-            map->setPointer(nodes[posCur].id, &nodes[posCur]);
+template <int D>
+void lazyHeap<D>::percolate_down(std::size_t pos, entry_t e)
+{
+    std::size_t end = last();
+
+    while (firstChild(pos) <= end) {
+        // Pick the smallest of the (up to D) children
+        std::size_t child = firstChild(pos);
+        std::size_t groupEnd = std::min(child + D - 1, end);
+        for (std::size_t c = child + 1; c <= groupEnd; ++c) {
+            if (entries[c].key < entries[child].key) child = c;
+        }
+
+        if (e.key > entries[child].key) {
+            entries[pos] = entries[child];
         } else break;
 
-        posCur = pos;
+        pos = child;
     }
 
-    nodes[posCur] = nodes[0];
-    map->setPointer(nodes[posCur].id, &nodes[posCur]);
+    entries[pos] = e;
 }
 
-heap::heap(std::size_t siz)
+template <int D>
+void lazyHeap<D>::percolate_up(std::size_t pos, entry_t e)
 {
-    map = new hashTable(siz * 2);
-    nodes.resize(siz + 1);
-    this->siz = siz;
-    use       = 0;
+    while (pos > root) {
+        std::size_t up = parent(pos);
+
+        if (e.key < entries[up].key) {
+            entries[pos] = entries[up];
+        } else break;
+
+        pos = up;
+    }
+
+    entries[pos] = e;
 }
 
-heap::~heap(void)
+template <int D>
+lazyHeap<D>::lazyHeap(std::size_t capacity)
 {
-	delete map;
+    entries.resize(capacity + D - 1);
+    use = 0;
 }
 
-int heap::insert(const std::string &id, int key, void *val)
+template <int D>
+int lazyHeap<D>::insert(std::size_t handle, int key)
 {
-    if (use + 1 > siz) return 1;
-    if (map->contains(id)) return 2;
+    if (handle > UINT32_MAX) return 1;
 
-    std::size_t pos = ++use;
-    nodes[pos].id  = id;
-    nodes[pos].key = key;
-    nodes[pos].val = val;
-    map->insert(id, &nodes[pos]);
+    try {
+        if (last() + 1 >= entries.size()) {
+            std::size_t capacity = entries.size() - (D - 1);
+            entries.resize(std::max<std::size_t>(16, capacity * 2) + D - 1);
+        }
+    } catch (const std::bad_alloc &) {
+        return 1;
+    }
 
-    if (use > 1) {
-        percolate_up(pos);
+    ++use;
+    percolate_up(last(), entry_t{key, static_cast<std::uint32_t>(handle)});
+    return 0;
+}
+
+template <int D>
+int lazyHeap<D>::deleteMin(std::size_t *handle, int *key)
+{
+    if (!use) return 1;
+
+    if (handle) *handle = entries[root].handle;
+    if (key)    *key    = entries[root].key;
+
+    entry_t moved = entries[last()];
+    use--;
+    if (use > 0) {
+        percolate_down(root, moved);
     }
     return 0;
 }
 
-int heap::setKey(const std::string &id, int key)
+radixHeap::radixHeap(std::size_t capacity)
 {
-    node_t *p = static_cast<node_t*>(map->getPointer(id));
-    if (p == nullptr) return 1;
+    where.assign(capacity, slot_t{absent, 0});
+    use = 0;
+    lastKey = 0;
+}
 
-    size_t pos = p - &nodes[0];
-    int posCur_key    = nodes[pos].key;
-    nodes[pos].key = key;
+void radixHeap::place(const entry_t &e)
+{
+    std::vector<entry_t> &bucket = buckets[bucketOf(e.key)];
+    where[e.handle] = slot_t{static_cast<std::uint32_t>(&bucket - buckets),
+                             static_cast<std::uint32_t>(bucket.size())};
+    bucket.push_back(e);
+}
 
-    if (key < posCur_key)
-        percolate_up(pos);
-    else
-        percolate_down(pos);
+radixHeap::entry_t radixHeap::take(slot_t s)
+{
+    // Fill the gap with the bucket's last entry
+    std::vector<entry_t> &bucket = buckets[s.bucket];
+    entry_t e = bucket[s.index];
+    bucket[s.index] = bucket.back();
+    where[bucket[s.index].handle].index = s.index;
+    bucket.pop_back();
+    where[e.handle].bucket = absent;
+    return e;
+}
+
+int radixHeap::insert(std::size_t handle, int key)
+{
+    if (handle > UINT32_MAX) return 1;
+    if (key < 0 || static_cast<std::uint32_t>(key) < lastKey) return 1;
+    if (contains(handle)) return 2;
+
+    try {
+        if (handle >= where.size()) {
+            where.resize(std::max(handle + 1, where.size() * 2), slot_t{absent, 0});
+        }
+        place(entry_t{static_cast<std::uint32_t>(key), static_cast<std::uint32_t>(handle)});
+    } catch (const std::bad_alloc &) {
+        return 1;
+    }
+    ++use;
+    return 0;
+}
+
+int radixHeap::setKey(std::size_t handle, int key)
+{
+    if (!contains(handle)) return 1;
+    if (key < 0 || static_cast<std::uint32_t>(key) < lastKey) return 1;
+
+    // Make room in the new bucket first, so a failure leaves the
+    // handle where it was
+    try {
+        std::vector<entry_t> &bucket = buckets[bucketOf(key)];
+        bucket.reserve(bucket.size() + 1);
+    } catch (const std::bad_alloc &) {
+        return 1;
+    }
+    entry_t e = take(where[handle]);
+    e.key = key;
+    place(e);
     return 0;
 }
 
-int heap::deleteMin(std::string *id, int *key, void **val)
+int radixHeap::deleteMin(std::size_t *handle, int *key)
 {
     if (!use) return 1;
 
-    if (id)  *id  = nodes[1].id;
-    if (key) *key = nodes[1].key;
-    if (val) *val = nodes[1].val;
+    if (buckets[0].empty()) {
+        int b = 1;
+        while (buckets[b].empty()) ++b;
 
-    map->remove(nodes[1].id);
-    
-    if (use > 1) {
-        nodes[1] = nodes[use--];
-        percolate_down(1);
-    } else {
-        use--;
+        // The smallest key in the bucket becomes the last key, and
+        // every entry of the bucket then belongs to a lower one
+        std::vector<entry_t> spread;
+        spread.swap(buckets[b]);
+        lastKey = spread[0].key;
+        for (const entry_t &e : spread) {
+            lastKey = std::min(lastKey, e.key);
+        }
+        for (const entry_t &e : spread) {
+            place(e);
+        }
+        // Hand the storage back so the bucket need not reallocate
+        spread.clear();
+        buckets[b].swap(spread);
     }
+
+    entry_t e = buckets[0].back();
+    buckets[0].pop_back();
+    where[e.handle].bucket = absent;
+    use--;
+
+    if (handle) *handle = e.handle;
+    if (key)    *key    = e.key;
     return 0;
 }
 
-int heap::remove(const std::string &id, int *key, void **val)
+int radixHeap::remove(std::size_t handle, int *key)
 {
-    node_t *p = static_cast<node_t*>(map->getPointer(id));
-    if (p == nullptr) return 1;
+    if (!contains(handle)) return 1;
 
-    if (key) *key = p->key;
-    if (val) *val = p->val;
+    entry_t e = take(where[handle]);
+    use--;
+    if (key) *key = e.key;
+    return 0;
+}
 
-    size_t pos = p - &nodes[0];
-    map->remove(id);
+void radixHeap::clear()
+{
+    for (std::vector<entry_t> &bucket : buckets) {
+        for (const entry_t &e : bucket) {
+            where[e.handle].bucket = absent;
+        }
+        bucket.clear();
+    }
+    use = 0;
+    lastKey = 0;
+}
 
-    if (pos != use) {
-        nodes[pos] = nodes[use--];
-        if ((pos > 1) && (nodes[pos].key < nodes[pos >> 1].key))
-            percolate_up(pos);
-        else
-            percolate_down(pos);
+bucketQueue::bucketQueue(int maxSpan, std::size_t capacity)
+{
+    buckets.resize(static_cast<std::size_t>(std::max(maxSpan, 0)) + 1);
+    where.assign(capacity, slot_t{0, absent});
+    use = 0;
+    lastKey = 0;
+}
+
+void bucketQueue::place(std::uint32_t handle, std::uint32_t key)
+{
+    std::vector<std::uint32_t> &bucket = buckets[key % buckets.size()];
+    where[handle] = slot_t{key, static_cast<std::uint32_t>(bucket.size())};
+    bucket.push_back(handle);
+}
+
+void bucketQueue::take(std::uint32_t handle)
+{
+    // Fill the gap with the bucket's last handle
+    slot_t s = where[handle];
+    std::vector<std::uint32_t> &bucket = buckets[s.key % buckets.size()];
+    bucket[s.index] = bucket.back();
+    where[bucket[s.index]].index = s.index;
+    bucket.pop_back();
+    where[handle].index = absent;
+}
+
+int bucketQueue::insert(std::size_t handle, int key)
+{
+    if (handle > UINT32_MAX) return 1;
+    if (!inWindow(key)) return 1;
+    if (contains(handle)) return 2;
+
+    try {
+        if (handle >= where.size()) {
+            where.resize(std::max(handle + 1, where.size() * 2), slot_t{0, absent});
+        }
+        place(static_cast<std::uint32_t>(handle), key);
+    } catch (const std::bad_alloc &) {
+        return 1;
+    }
+    ++use;
+    return 0;
+}
+
+int bucketQueue::setKey(std::size_t handle, int key)
+{
+    if (!contains(handle)) return 1;
+    if (!inWindow(key)) return 1;
+
+    // Make room in the new bucket first, so a failure leaves the
+    // handle where it was
+    try {
+        std::vector<std::uint32_t> &bucket = buckets[key % buckets.size()];
+        bucket.reserve(bucket.size() + 1);
+    } catch (const std::bad_alloc &) {
+        return 1;
+    }
+    take(handle);
+    place(handle, key);
+    return 0;
+}
+
+int bucketQueue::deleteMin(std::size_t *handle, int *key)
+{
+    if (!use) return 1;
+
+    // Every key is within the window, so a nonempty bucket turns up
+    // before the walk wraps around
+    std::size_t b = lastKey % buckets.size();
+    while (buckets[b].empty()) {
+        ++lastKey;
+        if (++b == buckets.size()) b = 0;
+    }
+
+    std::uint32_t h = buckets[b].back();
+    buckets[b].pop_back();
+    where[h].index = absent;
+    use--;
+
+    if (handle) *handle = h;
+    if (key)    *key    = lastKey;
+    return 0;
+}
+
+int bucketQueue::remove(std::size_t handle, int *key)
+{
+    if (!contains(handle)) return 1;
+
+    if (key) *key = where[handle].key;
+    take(handle);
+    use--;
+    return 0;
+}
+
+void bucketQueue::clear()
+{
+    for (std::vector<std::uint32_t> &bucket : buckets) {
+        for (std::uint32_t handle : bucket) {
+            where[handle].index = absent;
+        }
+        bucket.clear();
+    }
+    use = 0;
+    lastKey = 0;
+}
+
+template <int D>
+std::size_t dheap<D>::acquire()
+{
+    std::size_t handle;
+    if (!freeHandles.empty()) {
+        handle = freeHandles.back();
+        freeHandles.pop_back();
     } else {
-        use--;
+        // A new handle, numbered after every existing one
+        handle = ids.size();
+        ids.emplace_back();
+        vals.emplace_back();
     }
+    return handle;
+}
+
+template <int D>
+void dheap<D>::release(std::size_t handle)
+{
+    map->remove(ids[handle]);
+    ids[handle].clear();
+    vals[handle] = nullptr;
+    freeHandles.push_back(handle);
+}
+
+template <int D>
+dheap<D>::dheap(std::size_t siz, int flags)
+    : flags(flags), order(siz)
+{
+    map = new hashMap<std::string, std::size_t>(siz);
+    ids.resize(siz);
+    vals.resize(siz);
+    // Hand out low handles first
+    for (std::size_t handle = siz; handle > 0; --handle) {
+        freeHandles.push_back(handle - 1);
+    }
+}
+
+template <int D>
+dheap<D>::~dheap(void)
+{
+	delete map;
+}
+
+template <int D>
+int dheap<D>::insert(const std::string &id, int key, void *val)
+{
+    if (freeHandles.empty() && !(flags & GROWABLE)) return 1;
+    if (map->contains(id)) return 2;
+
+    std::size_t handle = acquire();
+    if (order.insert(handle, key) != 0) {
+        freeHandles.push_back(handle);
+        return 1;
+    }
+    ids[handle]  = id;
+    vals[handle] = val;
+    map->insert(id, handle);
+    return 0;
+}
+
+template <int D>
+int dheap<D>::setKey(const std::string &id, int key)
+{
+    std::size_t *p = map->find(id);
+    if (p == nullptr) return 1;
+
+    order.setKey(*p, key);
     return 0;
-}
\ No newline at end of file
+}
+
+template <int D>
+int dheap<D>::deleteMin(std::string *id, int *key, void **val)
+{
+    std::size_t handle;
+    if (order.deleteMin(&handle, key) != 0) return 1;
+
+    if (id)  *id  = ids[handle];
+    if (val) *val = vals[handle];
+    release(handle);
+    return 0;
+}
+
+template <int D>
+int dheap<D>::remove(const std::string &id, int *key, void **val)
+{
+    std::size_t *p = map->find(id);
+    if (p == nullptr) return 1;
+
+    std::size_t handle = *p;
+    order.remove(handle, key);
+    if (val) *val = vals[handle];
+    release(handle);
+    return 0;
+}
+
+template <int D>
+int dheap<D>::insertAll(const heapItem *items, std::size_t count)
+{
+    if (!(flags & GROWABLE) && count > freeHandles.size()) return 1;
+
+    std::vector<typename indexHeap<D>::item_t> handles;
+    handles.reserve(count);
+    int result = 0;
+    for (std::size_t i = 0; i < count; ++i) {
+        std::string id(items[i].id);
+        if (map->contains(id)) {
+            result = 2;
+            continue;
+        }
+        std::size_t handle = acquire();
+        ids[handle]  = id;
+        vals[handle] = items[i].val;
+        map->insert(id, handle);
+        handles.push_back({handle, items[i].key});
+    }
+
+    if (order.insertAll(handles.data(), handles.size()) == 1) {
+        for (const auto &item : handles) {
+            release(item.handle);
+        }
+        return 1;
+    }
+    return result;
+}
+
+template <int D>
+int dheap<D>::setKeys(const heapItem *items, std::size_t count)
+{
+    std::vector<typename indexHeap<D>::item_t> handles;
+    handles.reserve(count);
+    int result = 0;
+    for (std::size_t i = 0; i < count; ++i) {
+        std::size_t *p = map->find(std::string(items[i].id));
+        if (p == nullptr) {
+            result = 1;
+            continue;
+        }
+        handles.push_back({*p, items[i].key});
+    }
+    order.setKeys(handles.data(), handles.size());
+    return result;
+}
+
+template class indexHeap<2>;
+template class indexHeap<4>;
+template class indexHeap<8>;
+
+template class lazyHeap<2>;
+template class lazyHeap<4>;
+template class lazyHeap<8>;
+
+template class dheap<2>;
+template class dheap<4>;
+template class dheap<8>;
@@ -7,6 +7,7 @@
 
 #include <iostream>
 #include <string>
+#include <vector>
 #include <cstdlib>
 
 #include "heap.h"
@@ -34,6 +35,30 @@ void getInteger(string message, int &ref)
   }
 }
 
+// Read a number of id strings, each with an integer key, for the
+// batch calls; items refer to the strings in ids
+void getItems(string action, vector<string> &ids, vector<heapItem> &items)
+{
+  int count;
+  getInteger("How many items? ", count);
+
+  ids.clear();
+  items.clear();
+  for (int i = 0; i < count; i++) {
+    cout << "Enter an id string (to " << action << "): ";
+    string id;
+    getline(cin, id);
+    ids.push_back(id);
+
+    int key;
+    getInteger("Enter an associated integer key: ", key);
+    items.push_back(heapItem{string_view(), key, nullptr});
+  }
+  for (int i = 0; i < count; i++) {
+    items[i].id = ids[i];
+  }
+}
+
 int main()
 {
   int capacity = 0;
@@ -41,6 +66,8 @@ int main()
   string stringTmp;
   int key, id;
   int retVal;
+  vector<string> ids;
+  vector<heapItem> items;
 
   // Have user choose capacity for binary heap
   getInteger("Choose a capacity for the binary heap: ", capacity);
@@ -55,6 +82,8 @@ int main()
     cout << "3 - Delete a specified item\n";
     cout << "4 - Perform a deleteMin\n";
     cout << "5 - Quit\n";
+    cout << "6 - Insert several new items at once\n";
+    cout << "7 - Set the keys of several items at once\n";
 
     // Have the user choose an option
     getInteger("Choose an option: ", option);
@@ -120,6 +149,26 @@ int main()
       cout << "\nGoodbye!\n";
       exit(0);
 
+    case 6:
+      // Get several items from the user and insert them together
+
+      getItems("insert", ids, items);
+
+      retVal = myHeap1.insertAll(items.data(), items.size());
+      cout << "\nCall to 'insertAll' returned: " << retVal << "\n";
+
+      break;
+
+    case 7:
+      // Get several id strings and new keys and change them together
+
+      getItems("change its key", ids, items);
+
+      retVal = myHeap1.setKeys(items.data(), items.size());
+      cout << "\nCall to 'setKeys' returned: " << retVal << "\n";
+
+      break;
+
     default:
       cerr << "Error, that input is not valid!\n";
       exit (1);
@@ -2,77 +2,271 @@
 // ECE365 Fall 2025 HW3 Dijkstra's Implementation
 
 #include <iostream>
+#include <fstream>
+#include <sstream>
 #include <string>
-#include <ctime>
+#include <vector>
+#include <algorithm>
 #include <climits>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include "graph.h"
+#include "multiqueue.h"
+#include "query.h"
+#include "search.h"
 
 using namespace std;
 
-void dijkstra(Graph &graph, const string &startId) {
-    auto &nodes = graph.getNodes();
-    hashTable *nodeMap = graph.getNodeMap();
-    for (auto &node : nodes) {
-        node.dist = INT_MAX;
-        node.prev = nullptr;
-        node.known = false;
+// Dijkstra's algorithm from startId, leaving the results in the
+// graph; see shortestPaths.
+// Returns 0 on success, 1 if the queue ran out of memory.
+template <typename Queue>
+int dijkstra(Graph &graph, const string &startId, Queue &pq) {
+    return shortestPaths(graph, graph.findVertex(startId), pq, graph.result);
+}
+
+// Shortest paths from startId using threads threads that share a
+// multiQueue. The queue does not hand vertices out strictly in order
+// of distance, so a vertex may be settled more than once before its
+// distance is final (label correcting); what is returned matches
+// dijkstra(), though where paths tie the predecessor may differ.
+// Returns 0 on success, 1 if the queue ran out of memory.
+int parallelDijkstra(Graph &graph, const string &startId, unsigned threads) {
+    graph.resetSearch();
+    uint32_t start = graph.findVertex(startId);
+    if (start == Graph::noVertex) {
+        return 0;
     }
-    Graph::Node *startNode = graph.getNode(startId);
-    if (startNode == nullptr) {
-        return;
+    size_t n = graph.vertexCount();
+    const uint64_t *offsets = graph.edgeOffsets();
+    const uint32_t *targets = graph.edgeTargets();
+    const int *weights = graph.edgeWeights();
+
+    // Each vertex's label is its distance in the high half and its
+    // predecessor's index in the low half, so both change together
+    // in one compare and swap
+    auto label = [](int dist, uint64_t prev) {
+        return (static_cast<uint64_t>(dist) << 32) | prev;
+    };
+    unique_ptr<atomic<uint64_t>[]> labels(new atomic<uint64_t>[n]);
+    for (size_t i = 0; i < n; i++) {
+        labels[i].store(label(INT_MAX, Graph::noVertex), memory_order_relaxed);
     }
-    
-    startNode->dist = 0;
-    // Create heap based on the number of input nodes
-    heap pq(nodes.size());
-    for (auto &node : nodes) {
-        pq.insert(node.id, node.dist, &node);
+    labels[start].store(label(0, Graph::noVertex), memory_order_relaxed);
+
+    multiQueue pq(2 * threads);
+    if (pq.insert(start, 0) != 0) {
+        return 1;
     }
-    
-    // Main Dijkstra's algorithm loop
-    while (true) {
-        string minId;
-        int minDist;
-        void *pv;
-        
-        if (pq.deleteMin(&minId, &minDist, &pv) != 0) {
-            break;
+    // Entries inserted but not yet fully relaxed; the search is over
+    // when this reaches zero, or when an insert fails, since the
+    // vertex it lost would never be relaxed
+    atomic<size_t> pending(1);
+    atomic<bool> failed(false);
+
+    auto work = [&]() {
+        while (pending.load(memory_order_acquire) > 0 && !failed.load(memory_order_relaxed)) {
+            size_t v;
+            int dist;
+            if (pq.deleteMin(&v, &dist) != 0) {
+                this_thread::yield();
+                continue;
+            }
+            // Skip copies left behind by a shorter path
+            if (dist <= static_cast<int>(labels[v].load(memory_order_relaxed) >> 32)) {
+                for (size_t e = offsets[v]; e < offsets[v + 1]; e++) {
+                    uint32_t w = targets[e];
+                    int newDist = dist + weights[e];
+                    uint64_t old = labels[w].load(memory_order_relaxed);
+                    while (newDist < static_cast<int>(old >> 32)) {
+                        if (labels[w].compare_exchange_weak(old, label(newDist, v),
+                                                            memory_order_relaxed)) {
+                            pending.fetch_add(1, memory_order_relaxed);
+                            if (pq.insert(w, newDist) != 0) {
+                                pending.fetch_sub(1, memory_order_relaxed);
+                                failed.store(true, memory_order_relaxed);
+                            }
+                            break;
+                        }
+                    }
+                }
+            }
+            pending.fetch_sub(1, memory_order_acq_rel);
         }
-        
-        Graph::Node *v = static_cast<Graph::Node*>(pv);
-        
-        if (v->known || v->dist == INT_MAX) {
+    };
+
+    vector<thread> workers;
+    for (unsigned t = 1; t < threads; t++) {
+        workers.emplace_back(work);
+    }
+    work();
+    for (thread &worker : workers) {
+        worker.join();
+    }
+    if (failed.load()) {
+        return 1;
+    }
+
+    for (size_t v = 0; v < n; v++) {
+        uint64_t l = labels[v].load(memory_order_relaxed);
+        if (static_cast<int>(l >> 32) != INT_MAX) {
+            graph.result.reach(v, static_cast<int>(l >> 32), static_cast<uint32_t>(l));
+            graph.result.known[v] = true;
+        }
+    }
+    return 0;
+}
+
+// Read start vertex names from a file and write the shortest paths
+// from each of them to another, searching from all of them at once
+// with a queryEngine. Returns main's exit status.
+int runBatch(const Graph &graph) {
+    string startsFile;
+    cout << "Enter name of file of starting vertices: ";
+    cin >> startsFile;
+    ifstream startsIn(startsFile);
+    if (!startsIn) {
+        cerr << "Error: Could not open file " << startsFile << endl;
+        return 1;
+    }
+    vector<string> names;
+    vector<uint32_t> starts;
+    string name;
+    while (startsIn >> name) {
+        uint32_t start = graph.findVertex(name);
+        if (start == Graph::noVertex) {
+            cout << "Error: Vertex " << name << " does not exist in graph; skipped." << endl;
             continue;
         }
-        
-        v->known = true;
-        
-        // Update distances to adjacent nodes
-        for (const auto &edge : v->adjList) {
-            Graph::Node *w = static_cast<Graph::Node*>(nodeMap->getPointer(edge.destId));
-            
-            if (!w->known) {
-                int newDist = v->dist + edge.cost;
-                
-                if (newDist < w->dist) {
-                    w->dist = newDist;
-                    w->prev = v;
-                    pq.setKey(edge.destId, newDist);
-                }
-            }
+        names.push_back(name);
+        starts.push_back(start);
+    }
+
+    string outputFile;
+    cout << "Enter name of output file: ";
+    cin >> outputFile;
+    ofstream outfile(outputFile);
+    if (!outfile) {
+        cerr << "Error: Could not open output file." << endl;
+        return 1;
+    }
+
+    // Each search formats its own results, so the workers do not wait
+    // on one another to do it. Blocks are written in the order of the
+    // starts, each as soon as every earlier one is out; a worker more
+    // than one block per worker ahead of the file waits, so only a few
+    // formatted trees are held at once however many starts there are.
+    queryEngine engine(graph);
+    mutex writeLock;
+    condition_variable written;
+    map<size_t, string> ready; //formatted blocks waiting for earlier ones
+    size_t nextBlock = 0;
+    size_t window = engine.threadCount();
+    auto startTime = chrono::steady_clock::now();
+    int status = engine.run(starts.data(), starts.size(), [&](size_t i, const searchState &state) {
+        ostringstream out;
+        out << "From " << names[i] << ":" << endl;
+        graph.writeResults(out, state);
+
+        unique_lock<mutex> guard(writeLock);
+        written.wait(guard, [&] { return i < nextBlock + window; });
+        ready[i] = out.str();
+        while (!ready.empty() && ready.begin()->first == nextBlock) {
+            outfile << ready.begin()->second;
+            ready.erase(ready.begin());
+            nextBlock++;
         }
+        written.notify_all();
+    });
+    if (status != 0) {
+        cerr << "Error: Out of memory for the priority queue." << endl;
+        return 1;
     }
+    auto endTime = chrono::steady_clock::now();
+    double timeTaken = chrono::duration<double>(endTime - startTime).count();
+    cout << "Total time (in seconds) to run and write " << starts.size() << " searches on "
+         << engine.threadCount() << " threads: " << timeTaken << endl;
+    cout << "Time (in seconds) spent searching, added up over the threads: "
+         << engine.searchTime() << endl;
+    return 0;
 }
 
-int main() {
+// Usage:
+//   dijkstra.exe            run (prompts for names); the graph file
+//                           may be a text file or a snapshot
+//   dijkstra.exe --compile <graph> <snapshot>
+//                           write a text graph file as a snapshot
+//   dijkstra.exe --stats    run, then print the vertex map's statistics
+//   dijkstra.exe --heap     run with the 4-ary heap
+//   dijkstra.exe --lazy     run with a 4-ary heap without decrease-key,
+//                           skipping stale entries instead
+//   dijkstra.exe --radix    run with a radix heap
+//   dijkstra.exe --buckets  run with a bucket queue (Dial's algorithm)
+//   dijkstra.exe --parallel run on every core, sharing a MultiQueue
+//   dijkstra.exe --batch    search from every vertex named in a file,
+//                           on every core, one search per core at once
+// Without a queue option the bucket queue is used when no edge costs
+// more than bucketMaxCost, and the 4-ary heap otherwise; --buckets
+// falls back to the heap when an edge costs more than bucketLimit.
+// --stats may be combined with a queue option. Edge costs must not be
+// negative.
+int main(int argc, char **argv) {
+    if (argc == 4 && string(argv[1]) == "--compile") {
+        auto t1 = chrono::steady_clock::now();
+        Graph graph;
+        if (!graph.loadFromFile(argv[2])) {
+            cerr << "Error: Could not open file " << argv[2] << endl;
+            return 1;
+        }
+        if (!graph.saveSnapshot(argv[3])) {
+            cerr << "Error: Could not write " << argv[3] << endl;
+            return 1;
+        }
+        auto t2 = chrono::steady_clock::now();
+        cout << "Snapshot written. Time was " << chrono::duration<double>(t2 - t1).count()
+             << " seconds." << endl;
+        return 0;
+    }
+    bool showStats = false;
+    bool batch = false;
+    string queue; // empty until chosen
+    for (int i = 1; i < argc; i++) {
+        string option = argv[i];
+        if (option == "--stats") {
+            showStats = true;
+        } else if (option == "--batch") {
+            batch = true;
+        } else if (option == "--heap" || option == "--lazy" || option == "--radix" ||
+                   option == "--buckets" || option == "--parallel") {
+            queue = option.substr(2);
+        } else {
+            cerr << "Error: unknown option " << option << endl;
+            return 1;
+        }
+    }
     Graph graph;
     string graphFile;
     cout << "Enter name of graph file: ";
     cin >> graphFile;
-    if (!graph.loadFromFile(graphFile)) {
+    // A snapshot is mapped and used as is
+    if (Graph::isSnapshotFile(graphFile)) {
+        if (!graph.loadSnapshot(graphFile)) {
+            cerr << "Error: " << graphFile << " is not a valid snapshot file" << endl;
+            return 1;
+        }
+    } else if (!graph.loadFromFile(graphFile)) {
         cerr << "Error: Could not open file " << graphFile << endl;
         return 1;
     }
+    if (batch) {
+        return runBatch(graph);
+    }
     
     string startVertex;
     while (true) {
@@ -84,15 +278,58 @@ int main() {
         cout << "Error: Vertex does not exist in graph. Please try again." << endl;
     }
 
-    clock_t startTime = clock();
-    dijkstra(graph, startVertex);
-    clock_t endTime = clock();
-    double timeTaken = static_cast<double>(endTime - startTime) / CLOCKS_PER_SEC;
+    // Wall time rather than CPU time, which would add up the threads
+    // of a parallel run
+    auto startTime = chrono::steady_clock::now();
+    if (queue.empty()) {
+        queue = (graph.getMaxCost() <= bucketMaxCost) ? "buckets" : "heap";
+    } else if (queue == "buckets" && graph.getMaxCost() > bucketLimit) {
+        cout << "An edge costs more than " << bucketLimit
+             << ", too much for a bucket queue; using the heap instead." << endl;
+        queue = "heap";
+    }
+    unsigned threads = max(1u, thread::hardware_concurrency());
+    int status;
+    if (queue == "parallel") {
+        status = parallelDijkstra(graph, startVertex, threads);
+    } else if (queue == "lazy") {
+        lazyHeap<4> pq;
+        status = dijkstra(graph, startVertex, pq);
+    } else if (queue == "radix") {
+        radixHeap pq;
+        status = dijkstra(graph, startVertex, pq);
+    } else if (queue == "buckets") {
+        bucketQueue pq(graph.getMaxCost());
+        status = dijkstra(graph, startVertex, pq);
+    } else {
+        indexHeap<4> pq;
+        status = dijkstra(graph, startVertex, pq);
+    }
+    if (status != 0) {
+        cerr << "Error: Out of memory for the priority queue." << endl;
+        return 1;
+    }
+    auto endTime = chrono::steady_clock::now();
+    double timeTaken = chrono::duration<double>(endTime - startTime).count();
     cout << "Total time (in seconds) to apply Dijkstra's algorithm: " << timeTaken << endl;
+    if (queue == "parallel") {
+        cout << "Priority queue: multiqueue (" << threads << " threads)" << endl;
+    } else {
+        cout << "Priority queue: " << queue << " (largest edge cost " << graph.getMaxCost() << ")" << endl;
+    }
     string outputFile;
     cout << "Enter name of output file: ";
     cin >> outputFile;
     graph.writeOutput(outputFile, startVertex);
+
+    if (showStats) {
+#ifdef USE_SWISS
+        cout << "Table statistics are only kept by hashTable." << endl;
+#else
+        cout << endl << "Vertex map statistics:" << endl;
+        graph.getNodeMap()->getStats().print(cout);
+#endif
+    }
     
     return 0;
 }
\ No newline at end of file
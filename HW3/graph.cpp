@@ -1,23 +1,46 @@
 #include "graph.h"
 #include <fstream>
-#include <sstream>
 #include <iostream>
 #include <climits>
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
-Graph::Graph() {
-    nodeMap = new hashTable(1000000);
+const char Graph::snapshotMagic[8] = {'G', 'R', 'A', 'P', 'H', 'C', 'S', 'R'};
+
+Graph::Graph()
+    : maxCost(0), offsets(nullptr), targets(nullptr), weights(nullptr), edgeCount(0),
+      region(nullptr), regionSize(0), snapshotVertices(0),
+      nameOffsets(nullptr), nameSlots(nullptr), slotCount(0), names(nullptr) {
+    // Start small and grow the vertex map incrementally, so small
+    // graphs stay cheap and loading a large one never stalls on a
+    // single full rehash
+#ifdef USE_SWISS
+    nodeMap = new vertexMap();
+#else
+    nodeMap = new vertexMap(0, hashTable::INCREMENTAL);
+#endif
 }
 
 Graph::~Graph() {
     delete nodeMap;
+    if (region != nullptr) {
+        munmap(region, regionSize);
+    }
 }
 
 // Get or create a node 
-Graph::Node* Graph::getOrCreateNode(const std::string &id) {
+Graph::Node* Graph::getOrCreateNode(std::string_view id) {
     Node *node = static_cast<Node*>(nodeMap->getPointer(id));
     if (node == nullptr) {
-        nodes.push_back(Node(id));
+        nodes.push_back(Node(std::string(id), nodes.size()));
         node = &nodes.back();
+        vertices.push_back(node);
         nodeMap->insert(id, node);
     }
     
@@ -25,49 +48,426 @@ Graph::Node* Graph::getOrCreateNode(const std::string &id) {
 }
 
 // Load graph from file
+// The file is mapped into memory and cut at line breaks into one part
+// per thread. Each thread numbers the vertices of its part in order of
+// first appearance; the parts are then merged in file order, so every
+// vertex and edge gets the same number as a line by line read gives.
 bool Graph::loadFromFile(const std::string &filename) {
-    std::ifstream infile(filename);
-    if (!infile) {
+    if (region != nullptr) {
         return false;
     }
-    
-    std::string line;
-    while (std::getline(infile, line)) {
-        std::istringstream iss(line);
-        std::string src, dest;
-        int cost;
-        
-        if (iss >> src >> dest >> cost) {
-            Node *srcNode = getOrCreateNode(src);
-            getOrCreateNode(dest); 
-            srcNode->adjList.push_back(Node::Edge(dest, cost));
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+    std::size_t size = st.st_size;
+    void *mapped = nullptr;
+    if (size > 0) {
+        mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        return false;
+    }
+    const char *text = static_cast<const char *>(mapped);
+    const char *end = text + size;
+
+    std::size_t threads = std::max<std::size_t>(1, std::min<std::size_t>(
+        std::thread::hardware_concurrency(), size / minChunkBytes));
+    std::vector<const char *> bounds(threads + 1, end);
+    bounds[0] = text;
+    for (std::size_t t = 1; t < threads; t++) {
+        const char *cut = std::max(text + size / threads * t, bounds[t - 1]);
+        const char *newline = static_cast<const char *>(memchr(cut, '\n', end - cut));
+        bounds[t] = newline ? newline + 1 : end;
+    }
+
+    std::vector<LoadedChunk> chunks(threads);
+    std::vector<std::thread> workers;
+    for (std::size_t t = 1; t < threads; t++) {
+        workers.emplace_back(parseChunk, bounds[t], bounds[t + 1], std::ref(chunks[t]));
+    }
+    parseChunk(bounds[0], bounds[1], chunks[0]);
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+
+    std::vector<LoadedEdge> loaded;
+    std::vector<std::uint32_t> global;
+    for (const LoadedChunk &chunk : chunks) {
+        global.resize(chunk.names.size());
+        for (std::size_t i = 0; i < chunk.names.size(); i++) {
+            global[i] = getOrCreateNode(chunk.names[i])->index;
         }
+        for (const LoadedEdge &edge : chunk.edges) {
+            loaded.push_back(LoadedEdge{global[edge.src], global[edge.dest], edge.cost});
+        }
+        maxCost = std::max(maxCost, chunk.maxCost);
     }
-    
-    infile.close();
+
+    if (mapped != nullptr) {
+        munmap(mapped, size);
+    }
+    buildEdges(loaded);
     return true;
 }
 
+// Parse chunk function
+// A line holds a source name, a destination name and an integer cost,
+// separated by blanks; anything after the cost is ignored, and a line
+// without all three is skipped.
+void Graph::parseChunk(const char *begin, const char *end, LoadedChunk &chunk) {
+    hashMap<std::string_view, std::uint32_t> local;
+    auto blank = [](char c) {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+    };
+    auto vertexOf = [&](std::string_view name) {
+        std::uint32_t *index = local.find(name);
+        if (index != nullptr) {
+            return *index;
+        }
+        std::uint32_t next = chunk.names.size();
+        chunk.names.push_back(name);
+        local.insert(name, next);
+        return next;
+    };
+
+    const char *p = begin;
+    while (p < end) {
+        const char *lineEnd = static_cast<const char *>(memchr(p, '\n', end - p));
+        if (lineEnd == nullptr) {
+            lineEnd = end;
+        }
+
+        std::string_view tokens[2];
+        int found = 0;
+        for (; found < 2; found++) {
+            while (p < lineEnd && blank(*p)) p++;
+            const char *start = p;
+            while (p < lineEnd && !blank(*p)) p++;
+            if (p == start) break;
+            tokens[found] = std::string_view(start, p - start);
+        }
+
+        // The cost: an optional sign and at least one digit, in range
+        while (p < lineEnd && blank(*p)) p++;
+        bool negative = (p < lineEnd && (*p == '-' || *p == '+')) ? (*p++ == '-') : false;
+        long long cost = 0;
+        const char *digits = p;
+        while (p < lineEnd && *p >= '0' && *p <= '9' && cost <= INT_MAX) {
+            cost = cost * 10 + (*p++ - '0');
+        }
+        if (negative) cost = -cost;
+
+        if (found == 2 && p > digits && cost >= INT_MIN && cost <= INT_MAX) {
+            // Number the source before the destination, as a line by
+            // line read would
+            std::uint32_t src = vertexOf(tokens[0]);
+            std::uint32_t dest = vertexOf(tokens[1]);
+            chunk.edges.push_back(LoadedEdge{src, dest, static_cast<int>(cost)});
+            chunk.maxCost = std::max(chunk.maxCost, static_cast<int>(cost));
+        }
+        p = (lineEnd < end) ? lineEnd + 1 : end;
+    }
+}
+
+// Build the edge arrays
+void Graph::buildEdges(const std::vector<LoadedEdge> &loaded) {
+    std::size_t n = vertices.size();
+    std::size_t oldEdges = edgeCount;
+    std::vector<std::uint64_t> oldOffsets;
+    oldOffsets.swap(offsetStore);
+    oldOffsets.resize(n + 1, oldEdges); // Vertices added by this load have no old edges
+
+    // Count the edges leaving each vertex, then turn the counts into
+    // starting positions; offsetStore[v + 1] is used as v's write cursor
+    offsetStore.assign(n + 2, 0);
+    for (std::size_t v = 0; v < n; v++) {
+        offsetStore[v + 2] = oldOffsets[v + 1] - oldOffsets[v];
+    }
+    for (const auto &edge : loaded) {
+        offsetStore[edge.src + 2]++;
+    }
+    for (std::size_t v = 2; v < n + 2; v++) {
+        offsetStore[v] += offsetStore[v - 1];
+    }
+
+    std::vector<std::uint32_t> newTargets(oldEdges + loaded.size());
+    std::vector<int> newWeights(oldEdges + loaded.size());
+    for (std::size_t v = 0; v < n; v++) {
+        for (std::size_t e = oldOffsets[v]; e < oldOffsets[v + 1]; e++) {
+            std::size_t pos = offsetStore[v + 1]++;
+            newTargets[pos] = targetStore[e];
+            newWeights[pos] = weightStore[e];
+        }
+    }
+    for (const auto &edge : loaded) {
+        std::size_t pos = offsetStore[edge.src + 1]++;
+        newTargets[pos] = edge.dest;
+        newWeights[pos] = edge.cost;
+    }
+    offsetStore.pop_back();
+    targetStore.swap(newTargets);
+    weightStore.swap(newWeights);
+
+    offsets = offsetStore.data();
+    targets = targetStore.data();
+    weights = weightStore.data();
+    edgeCount = targetStore.size();
+    resetSearch();
+}
+
+// Clear the search results
+void Graph::resetSearch() {
+    result.reset(vertexCount());
+}
+
+// Search state reset function
+void searchState::reset(std::size_t vertices) {
+    if (dist.size() != vertices) {
+        dist.assign(vertices, INT_MAX);
+        prev.assign(vertices, UINT32_MAX);
+        known.assign(vertices, false);
+    } else {
+        for (std::uint32_t v : touched) {
+            dist[v] = INT_MAX;
+            prev[v] = UINT32_MAX;
+            known[v] = false;
+        }
+    }
+    touched.clear();
+}
+
+// Name hash function
+std::uint64_t Graph::nameHash(std::string_view name) {
+    std::uint64_t h = 0xcbf29ce484222325ull;
+    for (char c : name) {
+        h = (h ^ static_cast<unsigned char>(c)) * 0x100000001b3ull;
+    }
+    return h;
+}
+
+// Save snapshot function
+bool Graph::saveSnapshot(const std::string &filename) const {
+    std::size_t n = vertexCount();
+
+    // Pack the names, and index them in a table at most half full
+    std::vector<std::uint64_t> nameTable(n + 1);
+    std::string packed;
+    for (std::size_t v = 0; v < n; v++) {
+        nameTable[v] = packed.size();
+        packed += vertexName(v);
+    }
+    nameTable[n] = packed.size();
+    std::uint64_t slots = 1;
+    while (slots < 2 * n) {
+        slots *= 2;
+    }
+    std::vector<std::uint32_t> slotTable(slots, noVertex);
+    for (std::size_t v = 0; v < n; v++) {
+        std::uint64_t s = nameHash(vertexName(v)) & (slots - 1);
+        while (slotTable[s] != noVertex) {
+            s = (s + 1) & (slots - 1);
+        }
+        slotTable[s] = v;
+    }
+
+    snapshotHeader h;
+    memcpy(h.magic, snapshotMagic, sizeof(h.magic));
+    h.version = snapshotVersion;
+    h.maxCost = maxCost;
+    h.vertices = n;
+    h.edges = edgeCount;
+    h.slots = slots;
+    h.nameBytes = packed.size();
+
+    std::ofstream outFile(filename, std::ios::binary | std::ios::trunc);
+    if (!outFile) {
+        return false;
+    }
+    const char zeros[8] = {};
+    auto put = [&](const void *p, std::size_t bytes) {
+        if (bytes > 0) {
+            outFile.write(static_cast<const char *>(p), bytes);
+        }
+        outFile.write(zeros, align8(bytes) - bytes);
+    };
+    std::uint64_t noEdges = 0;
+    put(&h, sizeof(h));
+    put(n > 0 ? offsets : &noEdges, (n + 1) * sizeof(std::uint64_t));
+    put(targets, edgeCount * sizeof(std::uint32_t));
+    put(weights, edgeCount * sizeof(int));
+    put(nameTable.data(), nameTable.size() * sizeof(std::uint64_t));
+    put(slotTable.data(), slotTable.size() * sizeof(std::uint32_t));
+    put(packed.data(), packed.size());
+    return static_cast<bool>(outFile);
+}
+
+// Is snapshot file function
+bool Graph::isSnapshotFile(const std::string &filename) {
+    std::ifstream inFile(filename, std::ios::binary);
+    char magic[sizeof(snapshotMagic)];
+    return inFile.read(magic, sizeof(magic))
+        && memcmp(magic, snapshotMagic, sizeof(magic)) == 0;
+}
+
+// Load snapshot function
+bool Graph::loadSnapshot(const std::string &filename) {
+    if (region != nullptr || !vertices.empty()) {
+        return false;
+    }
+
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(snapshotHeader)) {
+        close(fd);
+        return false;
+    }
+    std::size_t size = st.st_size;
+    void *p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        return false;
+    }
+
+    // Check the header and that every array fits in the file
+    const snapshotHeader *h = static_cast<const snapshotHeader *>(p);
+    std::uint64_t n = h->vertices;
+    std::uint64_t m = h->edges;
+    if (memcmp(h->magic, snapshotMagic, sizeof(snapshotMagic)) != 0
+        || h->version != snapshotVersion || n >= noVertex || m > size || n > size
+        || h->slots < 2 * n || h->slots > size || (h->slots & (h->slots - 1)) != 0) {
+        munmap(p, size);
+        return false;
+    }
+    const char *base = static_cast<const char *>(p);
+    std::size_t at = align8(sizeof(snapshotHeader));
+    std::size_t offsetsAt = at;
+    at += align8((n + 1) * sizeof(std::uint64_t));
+    std::size_t targetsAt = at;
+    at += align8(m * sizeof(std::uint32_t));
+    std::size_t weightsAt = at;
+    at += align8(m * sizeof(int));
+    std::size_t nameOffsetsAt = at;
+    at += align8((n + 1) * sizeof(std::uint64_t));
+    std::size_t slotsAt = at;
+    at += align8(h->slots * sizeof(std::uint32_t));
+    std::size_t namesAt = at;
+    if (namesAt > size || h->nameBytes > size - namesAt) {
+        munmap(p, size);
+        return false;
+    }
+    const std::uint64_t *edgeOffsets = reinterpret_cast<const std::uint64_t *>(base + offsetsAt);
+    const std::uint32_t *edgeTargets = reinterpret_cast<const std::uint32_t *>(base + targetsAt);
+    const int *edgeWeights = reinterpret_cast<const int *>(base + weightsAt);
+    const std::uint64_t *nameTable = reinterpret_cast<const std::uint64_t *>(base + nameOffsetsAt);
+    const std::uint32_t *slotTable = reinterpret_cast<const std::uint32_t *>(base + slotsAt);
+    if (!validSnapshot(*h, edgeOffsets, edgeTargets, edgeWeights, nameTable, slotTable)) {
+        munmap(p, size);
+        return false;
+    }
+
+    region = p;
+    regionSize = size;
+    snapshotVertices = n;
+    maxCost = h->maxCost;
+    offsets = edgeOffsets;
+    targets = edgeTargets;
+    weights = edgeWeights;
+    edgeCount = m;
+    nameOffsets = nameTable;
+    nameSlots = slotTable;
+    slotCount = h->slots;
+    names = base + namesAt;
+    resetSearch();
+    return true;
+}
+
+// Check a snapshot's arrays
+bool Graph::validSnapshot(const snapshotHeader &h, const std::uint64_t *edgeOffsets,
+                          const std::uint32_t *edgeTargets, const int *edgeWeights,
+                          const std::uint64_t *nameTable, const std::uint32_t *slotTable) {
+    std::uint64_t n = h.vertices;
+    if (h.maxCost < 0 || edgeOffsets[0] != 0 || nameTable[0] != 0) {
+        return false;
+    }
+    for (std::uint64_t v = 0; v < n; v++) {
+        if (edgeOffsets[v] > edgeOffsets[v + 1] || nameTable[v] > nameTable[v + 1]) {
+            return false;
+        }
+    }
+    if (edgeOffsets[n] != h.edges || nameTable[n] != h.nameBytes) {
+        return false;
+    }
+    for (std::uint64_t e = 0; e < h.edges; e++) {
+        if (edgeTargets[e] >= n || edgeWeights[e] > h.maxCost) {
+            return false;
+        }
+    }
+    // findVertex stops at the first empty slot, so there must be one
+    std::uint64_t empty = 0;
+    for (std::uint64_t s = 0; s < h.slots; s++) {
+        if (slotTable[s] == noVertex) {
+            empty++;
+        } else if (slotTable[s] >= n) {
+            return false;
+        }
+    }
+    return empty > 0;
+}
+
 // Check if a vertex exists
 bool Graph::vertexExists(const std::string &id) {
-    return nodeMap->contains(id);
+    return findVertex(id) != noVertex;
 }
 
-// Get a node pointer by ID
-Graph::Node* Graph::getNode(const std::string &id) {
-    return static_cast<Node*>(nodeMap->getPointer(id));
+// Find a vertex by ID
+std::uint32_t Graph::findVertex(std::string_view id) const {
+    if (region == nullptr) {
+        Node *node = static_cast<Node*>(nodeMap->getPointer(id));
+        return node ? node->index : noVertex;
+    }
+    std::uint64_t s = nameHash(id) & (slotCount - 1);
+    while (nameSlots[s] != noVertex) {
+        if (vertexName(nameSlots[s]) == id) {
+            return nameSlots[s];
+        }
+        s = (s + 1) & (slotCount - 1);
+    }
+    return noVertex;
 }
 
-// Get the nodes list
-std::list<Graph::Node>& Graph::getNodes() {
-    return nodes;
+// Get the ID of a vertex
+std::string_view Graph::vertexName(std::uint32_t index) const {
+    if (region == nullptr) {
+        return vertices[index]->id;
+    }
+    return std::string_view(names + nameOffsets[index], nameOffsets[index + 1] - nameOffsets[index]);
+}
+
+// Get the number of vertices
+std::size_t Graph::vertexCount() const {
+    return region ? snapshotVertices : vertices.size();
 }
 
 // Get hash table (for node lookups in dijkstra)
-hashTable* Graph::getNodeMap() {
+vertexMap* Graph::getNodeMap() {
     return nodeMap;
 }
 
+// Get the largest edge cost
+int Graph::getMaxCost() const {
+    return maxCost;
+}
+
 // Write output to file
 void Graph::writeOutput(const std::string &filename, const std::string &startId) {
     std::ofstream outfile(filename);
@@ -76,33 +476,37 @@ void Graph::writeOutput(const std::string &filename, const std::string &startId)
         return;
     }
     
+    writeResults(outfile, result);
+    outfile.close();
+}
+
+// Write results of a search
+void Graph::writeResults(std::ostream &out, const searchState &state) const {
     // Write results for each node in order
-    for (const auto &node : nodes) {
-        outfile << node.id << ": ";
+    for (std::uint32_t v = 0; v < vertexCount(); v++) {
+        out << vertexName(v) << ": ";
         
-        if (node.dist == INT_MAX) {
-            outfile << "NO PATH" << std::endl;
+        if (state.dist[v] == INT_MAX) {
+            out << "NO PATH" << std::endl;
         } else {
-            outfile << node.dist << " [";
+            out << state.dist[v] << " [";
             
-            std::list<std::string> path;
-            const Node *current = &node;
-            while (current != nullptr) {
-                path.push_front(current->id);
-                current = current->prev;
+            std::list<std::string_view> path;
+            std::uint32_t current = v;
+            while (current != noVertex) {
+                path.push_front(vertexName(current));
+                current = state.prev[current];
             }
             bool first = true;
             for (const auto &id : path) {
                 if (!first) {
-                    outfile << ", ";
+                    out << ", ";
                 }
-                outfile << id;
+                out << id;
                 first = false;
             }
             
-            outfile << "]" << std::endl;
+            out << "]" << std::endl;
         }
     }
-    
-    outfile.close();
-}
\ No newline at end of file
+}
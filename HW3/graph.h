@@ -2,41 +2,195 @@
 #define _GRAPH_H
 
 #include <string>
+#include <string_view>
 #include <list>
+#include <ostream>
+#include <climits>
+#include <cstdint>
+#include <vector>
 #include "hash.h"
 #include "heap.h"
+#include "swisstable.h"
+
+// The vertex map engine; build with -DUSE_SWISS (make swiss)
+// to use the group-probed swissTable instead of hashTable.
+#ifdef USE_SWISS
+typedef swissTable vertexMap;
+#else
+typedef hashTable vertexMap;
+#endif
+
+// The working state of one shortest path search, by vertex index:
+// the distance from the start (INT_MAX if there is no path), the
+// previous vertex on the path (UINT32_MAX for the start and unreached
+// vertices), and whether the distance is final. touched lists the
+// vertices whose entries a search changed, so reset only has to undo
+// those; reusing a state costs in proportion to the part of the graph
+// the last search reached, not to the size of the graph.
+class searchState {
+public:
+    std::vector<int> dist;
+    std::vector<std::uint32_t> prev;
+    std::vector<char> known;
+    std::vector<std::uint32_t> touched;
+
+    // Set every vertex of a graph with the specified number of
+    // vertices to unreached.
+    void reset(std::size_t vertices);
+
+    // Give vertex v the distance d by way of vertex from.
+    void reach(std::uint32_t v, int d, std::uint32_t from) {
+        if (dist[v] == INT_MAX) {
+            touched.push_back(v);
+        }
+        dist[v] = d;
+        prev[v] = from;
+    }
+};
 
 class Graph {
 private:
-    // Nodes and Edges
+    // A vertex: its name and its number
     class Node {
     public:
-        class Edge {
-        public:
-            std::string destId;
-            int cost;
-            
-            Edge(const std::string &dest, int c) : destId(dest), cost(c) {}
-        };
-        
         std::string id;
-        std::list<Edge> adjList;
-        int dist;
-        Node *prev;
-        bool known;
+        std::size_t index; // Position in nodes; vertices are numbered from 0.
         
-        Node(const std::string &vertexId) 
-            : id(vertexId), dist(INT_MAX), prev(nullptr), known(false) {}
+        Node(const std::string &vertexId, std::size_t vertexIndex) 
+            : id(vertexId), index(vertexIndex) {}
     };
     std::list<Node> nodes;
-    hashTable *nodeMap;
-    Node* getOrCreateNode(const std::string &id);
+    std::vector<Node*> vertices; // Index -> node
+    vertexMap *nodeMap;
+    int maxCost; // Largest edge cost loaded
+
+    // The edges in compressed sparse row form, by vertex index: the
+    // edges leaving vertex v are numbered offsets[v] to
+    // offsets[v + 1] - 1, in the order they were loaded, and edge e
+    // goes to targets[e] at a cost of weights[e]. A search reads them
+    // front to back without touching a string or the vertex map.
+    // The arrays point into the stores below, or into a snapshot.
+    const std::uint64_t *offsets;
+    const std::uint32_t *targets;
+    const int *weights;
+    std::size_t edgeCount;
+    std::vector<std::uint64_t> offsetStore;
+    std::vector<std::uint32_t> targetStore;
+    std::vector<int> weightStore;
+
+    // A snapshot file holds a header and then, each starting on an
+    // 8-byte boundary: offsets[vertices + 1] (uint64),
+    // targets[edges] (uint32), weights[edges] (int32),
+    // nameOffsets[vertices + 1] (uint64), nameSlots[slots] (uint32),
+    // then the packed vertex names. nameSlots is an open addressing
+    // table of vertex indices (noVertex where empty), probed linearly
+    // from nameHash(name). The file is written in the byte order of
+    // the machine that built it and is only meant to be loaded on the
+    // same kind of machine.
+    class snapshotHeader {
+    public:
+        char magic[8];
+        std::uint32_t version;
+        std::int32_t maxCost;
+        std::uint64_t vertices;
+        std::uint64_t edges;
+        std::uint64_t slots; // A power of two, at least twice vertices.
+        std::uint64_t nameBytes;
+    };
+
+    static const char snapshotMagic[8];
+    static constexpr std::uint32_t snapshotVersion = 1;
+
+    // A mapped snapshot and views into it; region is nullptr for a
+    // graph loaded from text, which keeps its names in nodes instead.
+    void *region;
+    std::size_t regionSize;
+    std::size_t snapshotVertices;
+    const std::uint64_t *nameOffsets;
+    const std::uint32_t *nameSlots;
+    std::uint64_t slotCount;
+    const char *names;
+
+    // The name hash of the snapshot's name index (64-bit FNV-1a), the
+    // same on every build.
+    static std::uint64_t nameHash(std::string_view name);
+
+    // Check that a snapshot's arrays are consistent with its header,
+    // so that no search or lookup on it can index out of bounds or
+    // probe forever: offsets start at 0, never decrease and end at
+    // their array's size, every target is a vertex, no weight is
+    // above maxCost, and the name index holds only vertices and at
+    // least one empty slot.
+    static bool validSnapshot(const snapshotHeader &h, const std::uint64_t *edgeOffsets,
+                              const std::uint32_t *edgeTargets, const int *edgeWeights,
+                              const std::uint64_t *nameTable, const std::uint32_t *slotTable);
+
+    // Round a byte count up to a multiple of 8.
+    static std::size_t align8(std::size_t size) { return (size + 7) & ~std::size_t(7); }
+
+    // Results of the last search by dijkstra or parallelDijkstra
+    searchState result;
+
+    Node* getOrCreateNode(std::string_view id);
+
+    // An edge as read from the file, before it goes into the arrays.
+    class LoadedEdge {
+    public:
+        std::uint32_t src;
+        std::uint32_t dest;
+        int cost;
+    };
+
+    // What one thread makes of its part of the file: the vertex
+    // names in the order they first appear in it, and its edges,
+    // with vertices numbered in that order.
+    class LoadedChunk {
+    public:
+        std::vector<std::string_view> names;
+        std::vector<LoadedEdge> edges;
+        int maxCost = 0;
+    };
+
+    // Smallest part of the file worth a thread of its own.
+    static const std::size_t minChunkBytes = 1 << 20;
+
+    // Parse the lines from begin to end, which ends at a line break
+    // or the end of the file. The names point into the text.
+    static void parseChunk(const char *begin, const char *end, LoadedChunk &chunk);
+
+    // Rebuild the arrays from the edges already in them followed by
+    // the specified ones.
+    void buildEdges(const std::vector<LoadedEdge> &loaded);
+
+    // Clear the results and size them for every vertex.
+    void resetSearch();
 public:
+    // The index of no vertex
+    static constexpr std::uint32_t noVertex = UINT32_MAX;
+
     Graph();
     ~Graph();
+
+    Graph(const Graph &) = delete;
+    Graph &operator=(const Graph &) = delete;
     
-    // Load graph from file
+    // Load graph from file (not into a graph loaded from a snapshot)
     bool loadFromFile(const std::string &filename);
+
+    // Write the graph to a snapshot file.
+    // Returns true on success, false if the file cannot be written.
+    bool saveSnapshot(const std::string &filename) const;
+
+    // Map a snapshot file into memory and use it as the graph, with no
+    // parsing or table building. The graph must be empty. Every array
+    // is checked once before use (see validSnapshot), in time linear
+    // in the file size, so a corrupt file is rejected.
+    // Returns true on success, false if the graph is not empty or the
+    // file cannot be opened or is not a valid snapshot.
+    bool loadSnapshot(const std::string &filename);
+
+    // Check whether filename starts with the snapshot file header.
+    static bool isSnapshotFile(const std::string &filename);
     
     // Check if a vertex exists
     bool vertexExists(const std::string &id);
@@ -44,15 +198,37 @@ public:
     // Write results to output file
     void writeOutput(const std::string &filename, const std::string &startId);
 
-    // Get a node pointer by ID (for external use)
-    Node* getNode(const std::string &id);
-    
-    // Get the nodes list (for external iteration)
-    std::list<Node>& getNodes();
+    // Write the results of a search to out, one line per vertex
+    void writeResults(std::ostream &out, const searchState &state) const;
+
+    // Get the index of a vertex by ID, or noVertex if there is none
+    std::uint32_t findVertex(std::string_view id) const;
+
+    // Get the ID of a vertex by index
+    std::string_view vertexName(std::uint32_t index) const;
+
+    // Number of vertices
+    std::size_t vertexCount() const;
     
-    // Get the node map (for lookups in dijkstra)
-    hashTable* getNodeMap();
-    friend void dijkstra(Graph &graph, const std::string &startId);
+    // Get the node map (empty for a graph loaded from a snapshot)
+    vertexMap* getNodeMap();
+
+    // Get the largest edge cost in the graph (0 if it has no edges)
+    int getMaxCost() const;
+
+    // Get the edge arrays; see offsets. They do not change once the
+    // graph is loaded, so any number of searches may read them at once.
+    const std::uint64_t* edgeOffsets() const { return offsets; }
+    const std::uint32_t* edgeTargets() const { return targets; }
+    const int* edgeWeights() const { return weights; }
+
+    // Dijkstra's algorithm over an empty priority queue of vertex
+    // indices (indexHeap<4>, lazyHeap<4>, radixHeap or bucketQueue).
+    template <typename Queue>
+    friend int dijkstra(Graph &graph, const std::string &startId, Queue &pq);
+
+    // Label-correcting shortest paths on several threads at once.
+    friend int parallelDijkstra(Graph &graph, const std::string &startId, unsigned threads);
 };
 
 #endif // _GRAPH_H
\ No newline at end of file
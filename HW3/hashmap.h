@@ -0,0 +1,275 @@
+#ifndef _HASHMAP_H
+#define _HASHMAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// The default hash function for hashMap.
+// Integer keys are used as their own hash value; hashMap scrambles
+// every hash with a multiply before picking a slot, which is enough
+// to spread them. Everything else goes through std::hash.
+template <typename Key, typename Enable = void>
+struct hashOf {
+  std::size_t operator()(const Key &key) const { return std::hash<Key>()(key); }
+};
+
+template <typename Key>
+struct hashOf<Key, typename std::enable_if<std::is_integral<Key>::value>::type> {
+  std::size_t operator()(Key key) const { return static_cast<std::size_t>(key); }
+};
+
+// A header-only hash table mapping keys of type Key to values of
+// type Value, so the hash and compare calls can be inlined and no
+// casts are needed at the call site. Uses linear probing in a power
+// of two table with backward shift deletion (no tombstones).
+//
+// hashMap<std::string, void *> is specialized in hash.h as the
+// string-keyed hashTable, which keeps its own interface.
+template <typename Key, typename Value,
+          typename Hash = hashOf<Key>, typename Eq = std::equal_to<Key>>
+class hashMap {
+
+ public:
+
+  // The constructor initializes the hash table with room
+  // for at least the specified number of items.
+  hashMap(int size = 0);
+
+  // Insert the specified key with the specified value.
+  // Returns 0 on success,
+  // 1 if key already exists in hash table,
+  // 2 if rehash fails.
+  int insert(const Key &key, const Value &value = Value());
+
+  // Check if the specified key is in the hash table.
+  bool contains(const Key &key) const;
+
+  // Return a pointer to the value stored for the specified key,
+  // or nullptr if the key is not in the hash table. The pointer
+  // is valid until the next insert or remove.
+  Value *find(const Key &key);
+
+  // Get the value associated with the specified key.
+  // If the key does not exist in the hash table, return Value().
+  // If an optional pointer to a bool is provided,
+  // set the bool to true if the key is in the hash table,
+  // and set the bool to false otherwise.
+  Value getValue(const Key &key, bool *b = nullptr) const;
+
+  // Set the value associated with the specified key.
+  // Returns 0 on success,
+  // 1 if the key does not exist in the hash table.
+  int setValue(const Key &key, const Value &value);
+
+  // Delete the item with the specified key.
+  // Returns true on success,
+  // false if the specified key is not in the hash table.
+  bool remove(const Key &key);
+
+  // Number of items in the hash table.
+  std::size_t size() const { return filled; }
+
+ private:
+
+  class hashItem {
+  public:
+    Key key {};
+    Value value {};
+    bool isOccupied {false};
+
+    hashItem() = default;
+  };
+
+  std::size_t capacity; // Always a power of two.
+  std::size_t filled; // Number of items in the table.
+  int shift; // 64 - log2(capacity); see home().
+
+  std::vector<hashItem> data; // The actual entries are here.
+
+  Hash hasher;
+  Eq equal;
+
+  // The slot a key hashes to: the top bits of the hash value
+  // multiplied by 2^64 / golden ratio (Fibonacci hashing).
+  std::size_t home(const Key &key) const {
+    return (static_cast<std::uint64_t>(hasher(key)) * 0x9E3779B97F4A7C15ull) >> shift;
+  }
+
+  // Search for an item with the specified key.
+  // Return the position if found, -1 otherwise.
+  long findPos(const Key &key) const;
+
+  // The rehash function; moves every item into a table
+  // of the specified capacity.
+  // Returns true on success, false if memory allocation fails.
+  bool rehash(std::size_t newCapacity);
+
+  // Return the smallest power of two capacity (at least 16)
+  // that keeps size items at or below half full.
+  static std::size_t getCapacity(std::size_t size);
+
+  // Return 64 - log2(capacity) for a power of two capacity.
+  static int getShift(std::size_t capacity);
+};
+
+// Constructor
+template <typename Key, typename Value, typename Hash, typename Eq>
+hashMap<Key, Value, Hash, Eq>::hashMap(int size) {
+    capacity = getCapacity(size > 0 ? size : 0);
+    filled = 0;
+    shift = getShift(capacity);
+    data.resize(capacity);
+}
+
+// Insert function
+template <typename Key, typename Value, typename Hash, typename Eq>
+int hashMap<Key, Value, Hash, Eq>::insert(const Key &key, const Value &value) {
+    if (findPos(key) != -1) {
+        return 1;
+    }
+    if (filled >= capacity / 2) {
+        if (!rehash(capacity * 2)) {
+            return 2;
+        }
+    }
+
+    std::size_t mask = capacity - 1;
+    std::size_t pos = home(key);
+    while (data[pos].isOccupied) {
+        pos = (pos + 1) & mask;
+    }
+    data[pos].key = key;
+    data[pos].value = value;
+    data[pos].isOccupied = true;
+    filled++;
+    return 0;
+}
+
+// Contains function
+template <typename Key, typename Value, typename Hash, typename Eq>
+bool hashMap<Key, Value, Hash, Eq>::contains(const Key &key) const {
+    return findPos(key) != -1;
+}
+
+// Find function
+template <typename Key, typename Value, typename Hash, typename Eq>
+Value *hashMap<Key, Value, Hash, Eq>::find(const Key &key) {
+    long pos = findPos(key);
+    return pos != -1 ? &data[pos].value : nullptr;
+}
+
+// Get value function
+template <typename Key, typename Value, typename Hash, typename Eq>
+Value hashMap<Key, Value, Hash, Eq>::getValue(const Key &key, bool *b) const {
+    long pos = findPos(key);
+    if (b != nullptr) {
+        *b = (pos != -1);
+    }
+    return pos != -1 ? data[pos].value : Value();
+}
+
+// Set value function
+template <typename Key, typename Value, typename Hash, typename Eq>
+int hashMap<Key, Value, Hash, Eq>::setValue(const Key &key, const Value &value) {
+    long pos = findPos(key);
+    if (pos == -1) {
+        return 1;
+    }
+    data[pos].value = value;
+    return 0;
+}
+
+// Remove function
+template <typename Key, typename Value, typename Hash, typename Eq>
+bool hashMap<Key, Value, Hash, Eq>::remove(const Key &key) {
+    long found = findPos(key);
+    if (found == -1) {
+        return false;
+    }
+
+    // Backward shift: walk the rest of the chain and move back
+    // every item whose home slot is not between the hole and itself
+    std::size_t mask = capacity - 1;
+    std::size_t pos = found;
+    std::size_t next = (pos + 1) & mask;
+    while (data[next].isOccupied) {
+        std::size_t dist = (next - home(data[next].key)) & mask;
+        std::size_t gap = (next - pos) & mask;
+        if (dist >= gap) {
+            data[pos] = std::move(data[next]);
+            pos = next;
+        }
+        next = (next + 1) & mask;
+    }
+    data[pos] = hashItem();
+    filled--;
+    return true;
+}
+
+// Find position function
+template <typename Key, typename Value, typename Hash, typename Eq>
+long hashMap<Key, Value, Hash, Eq>::findPos(const Key &key) const {
+    std::size_t mask = capacity - 1;
+    std::size_t pos = home(key);
+    while (data[pos].isOccupied) {
+        if (equal(data[pos].key, key)) {
+            return pos;
+        }
+        pos = (pos + 1) & mask;
+    }
+    return -1;
+}
+
+// Rehash function
+template <typename Key, typename Value, typename Hash, typename Eq>
+bool hashMap<Key, Value, Hash, Eq>::rehash(std::size_t newCapacity) {
+    std::vector<hashItem> oldData;
+    try {
+        oldData.resize(newCapacity);
+    } catch (const std::bad_alloc &) {
+        return false;
+    }
+    data.swap(oldData);
+    capacity = newCapacity;
+    shift = getShift(capacity);
+
+    std::size_t mask = capacity - 1;
+    for (auto &item : oldData) {
+        if (item.isOccupied) {
+            std::size_t pos = home(item.key);
+            while (data[pos].isOccupied) {
+                pos = (pos + 1) & mask;
+            }
+            data[pos] = std::move(item);
+        }
+    }
+    return true;
+}
+
+// Get capacity function
+template <typename Key, typename Value, typename Hash, typename Eq>
+std::size_t hashMap<Key, Value, Hash, Eq>::getCapacity(std::size_t size) {
+    std::size_t capacity = 16;
+    while (capacity < size * 2) {
+        capacity <<= 1;
+    }
+    return capacity;
+}
+
+// Get shift function
+template <typename Key, typename Value, typename Hash, typename Eq>
+int hashMap<Key, Value, Hash, Eq>::getShift(std::size_t capacity) {
+    int shift = 64;
+    while (capacity > 1) {
+        capacity >>= 1;
+        shift--;
+    }
+    return shift;
+}
+
+#endif //_HASHMAP_H
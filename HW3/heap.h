@@ -1,29 +1,431 @@
+#ifndef _HEAP_H
+#define _HEAP_H
+
 #include <cstddef>
+#include <cstdint>
+#include <new>
 #include <string>
+#include <string_view>
 #include <vector>
-#include "hash.h"
-class heap {
-      
-    typedef struct node_s {
-        std::string id;
+#include "hashmap.h"
+
+// An allocator that places every array on a cache line boundary,
+// so the heap's child groups line up with cache lines.
+template <typename T>
+class alignedAllocator {
+    public:
+        typedef T value_type;
+        static constexpr std::size_t alignment = 64;
+
+        alignedAllocator() = default;
+        template <typename U> alignedAllocator(const alignedAllocator<U> &) {}
+
+        T *allocate(std::size_t n) {
+            return static_cast<T *>(::operator new(n * sizeof(T), std::align_val_t(alignment)));
+        }
+        void deallocate(T *p, std::size_t) {
+            ::operator delete(p, std::align_val_t(alignment));
+        }
+
+        template <typename U> bool operator==(const alignedAllocator<U> &) const { return true; }
+        template <typename U> bool operator!=(const alignedAllocator<U> &) const { return false; }
+};
+
+// A min-heap of integer handles, each with an int key, where every
+// node has D children (D = 2, 4 or 8; the instances are compiled in
+// heap.cpp). Callers keep whatever goes with a handle in their own
+// arrays, indexed by handle. The heap grows as handles are inserted;
+// since positions are kept by handle rather than by pointer, growing
+// never invalidates anything a caller holds.
+//
+// A wider heap is shallower, so deleteMin moves an entry through
+// fewer levels, each of which compares the D children side by side
+// in memory. The root sits at entries[D - 1], which puts the children
+// of every node in a group starting at a multiple of D; with the
+// aligned storage a group of 8 is exactly one cache line. For D = 2
+// this is the classic layout with the root at entries[1].
+//
+// Entries are a key and a handle, eight bytes, and each handle's
+// position is kept in a plain array, so moving an entry never
+// touches a hash table or a string. Percolation uses the hole
+// technique: the moving entry is held aside while the entries in
+// its way shift into the hole, and is written once at the end.
+template <int D>
+class indexHeap {
+
+    typedef struct entry_s {
+        int key;
+        std::uint32_t handle;
+    } entry_t;
+
+    static constexpr std::size_t root = D - 1;
+    static constexpr std::size_t absent = SIZE_MAX;
+
+    // Position of the first child and of the parent of pos.
+    static std::size_t firstChild(std::size_t pos) { return D * (pos - D + 2); }
+    static std::size_t parent(std::size_t pos) { return pos / D + D - 2; }
+
+    // Position of the last entry in use.
+    std::size_t last() const { return use + D - 2; }
+
+    // Move e up (or down) from the hole at pos to its place.
+    void percolate_up(std::size_t pos, entry_t e);
+    void percolate_down(std::size_t pos, entry_t e);
+
+    // Put e at pos and record its position.
+    void place(std::size_t pos, const entry_t &e) {
+        entries[pos] = e;
+        where[e.handle] = pos;
+    }
+
+    std::size_t use; //number of handles in the heap
+    std::vector<entry_t, alignedAllocator<entry_t>> entries; //actual d-ary heap
+    std::vector<std::size_t> where; //handle -> position in entries, or absent
+
+    // Make room for handle and count more entries.
+    // Returns true on success, false if memory allocation fails.
+    bool grow(std::size_t handle, std::size_t count = 1);
+
+    // Restore heap order over all entries, bottom up (Floyd's
+    // method); O(size) however out of order they are.
+    void heapify();
+
+    // Whether changing count entries of a heap that will hold size
+    // entries is cheaper done by rebuilding the whole heap than by
+    // moving each one on its own.
+    bool rebuildCheaper(std::size_t count, std::size_t size) const;
+
+    public:
+        // A handle and its key, for insertAll and setKeys.
+        typedef struct item_s {
+            std::size_t handle;
+            int key;
+        } item_t;
+
+        // The constructor makes room for handles 0 to capacity - 1;
+        // larger handles (below 2^32) make the heap grow.
+        indexHeap(std::size_t capacity = 0);
+
+        // Insert the specified handle with the specified key.
+        // Returns 0 on success,
+        // 1 if the handle is 2^32 or more, or memory runs out,
+        // 2 if the handle is already in the heap.
+        int insert(std::size_t handle, int key);
+
+        // Insert count items at once. A large batch is appended and
+        // the heap rebuilt once, in time linear in the final size,
+        // instead of percolating every item up.
+        // Returns 0 on success,
+        // 1 if a handle is 2^32 or more, or memory runs out
+        //   (nothing is inserted),
+        // 2 if some handles were already in the heap or repeated
+        //   (those are skipped; the rest are inserted).
+        int insertAll(const item_t *items, std::size_t count);
+
+        // Change the key of the specified handle.
+        // Returns 0 on success,
+        // 1 if the handle is not in the heap.
+        int setKey(std::size_t handle, int key);
+
+        // Change the keys of count handles at once; a large batch
+        // is applied in place and heap order restored once.
+        // Returns 0 on success,
+        // 1 if some handles were not in the heap (those are skipped).
+        int setKeys(const item_t *items, std::size_t count);
+
+        // Remove the handle with the smallest key, and provide its
+        // handle and key if the pointers are not nullptr.
+        // Returns 0 on success,
+        // 1 if the heap is empty.
+        int deleteMin(std::size_t *handle = nullptr, int *key = nullptr);
+
+        // Remove the specified handle, and provide its key if the
+        // pointer is not nullptr.
+        // Returns 0 on success,
+        // 1 if the handle is not in the heap.
+        int remove(std::size_t handle, int *key = nullptr);
+
+        // Check if the specified handle is in the heap.
+        bool contains(std::size_t handle) const {
+            return handle < where.size() && where[handle] != absent;
+        }
+
+        // Number of handles in the heap.
+        std::size_t size() const { return use; }
+};
+
+// A min-heap of integer handles with int keys that keeps no record of
+// where a handle is, laid out as indexHeap<D>. A handle may be in it
+// any number of times; instead of changing a key, insert the handle
+// again with the new one and skip the stale copies as they come out
+// (lazy deletion). The heap is then nothing but a plain array of
+// key/handle pairs, which is smaller and cheaper to update than
+// indexHeap's position array when few copies go stale, as in
+// Dijkstra's algorithm on sparse graphs.
+template <int D>
+class lazyHeap {
+
+    typedef struct entry_s {
+        int key;
+        std::uint32_t handle;
+    } entry_t;
+
+    static constexpr std::size_t root = D - 1;
+
+    // Position of the first child and of the parent of pos.
+    static std::size_t firstChild(std::size_t pos) { return D * (pos - D + 2); }
+    static std::size_t parent(std::size_t pos) { return pos / D + D - 2; }
+
+    // Position of the last entry in use.
+    std::size_t last() const { return use + D - 2; }
+
+    // Move e up (or down) from the hole at pos to its place.
+    void percolate_up(std::size_t pos, entry_t e);
+    void percolate_down(std::size_t pos, entry_t e);
+
+    std::size_t use; //number of entries in the heap
+    std::vector<entry_t, alignedAllocator<entry_t>> entries; //actual d-ary heap
+
+    public:
+        // The constructor makes room for capacity entries; the heap
+        // grows past that as needed.
+        lazyHeap(std::size_t capacity = 0);
+
+        // Insert the specified handle with the specified key, whether
+        // or not it is in the heap already.
+        // Returns 0 on success,
+        // 1 if the handle is 2^32 or more, or memory runs out.
+        int insert(std::size_t handle, int key);
+
+        // Remove an entry with the smallest key, and provide its
+        // handle and key if the pointers are not nullptr.
+        // Returns 0 on success,
+        // 1 if the heap is empty.
+        int deleteMin(std::size_t *handle = nullptr, int *key = nullptr);
+
+        // The smallest key in the heap, which must not be empty.
+        int minKey() const { return entries[root].key; }
+
+        // Number of entries in the heap, stale copies included.
+        std::size_t size() const { return use; }
+};
+
+// A radix heap: a min-heap of integer handles with non-negative int
+// keys, for when keys are removed in nondecreasing order, as the
+// distances in Dijkstra's algorithm are. No key may be below the last
+// one removed. It has the same interface as indexHeap.
+//
+// Entries sit in 33 buckets by the highest bit in which their key
+// differs from the last key removed; bucket 0 holds keys equal to it.
+// deleteMin takes from bucket 0, and when that is empty finds the
+// smallest key in the first nonempty bucket, makes it the last key,
+// and spreads that bucket over the ones below. An entry only ever
+// moves to a lower bucket, so each costs O(log C) moves over its life
+// (C the largest key), and nothing is ever compared in a tree.
+class radixHeap {
+
+    typedef struct entry_s {
+        std::uint32_t key;
+        std::uint32_t handle;
+    } entry_t;
+
+    // Where a handle's entry is: its bucket and index in the bucket.
+    typedef struct slot_s {
+        std::uint32_t bucket;
+        std::uint32_t index;
+    } slot_t;
+
+    static constexpr int bucketCount = 33;
+    static constexpr std::uint32_t absent = UINT32_MAX;
+
+    std::size_t use; //number of handles in the heap
+    std::uint32_t lastKey; //key last removed by deleteMin
+    std::vector<entry_t> buckets[bucketCount];
+    std::vector<slot_t> where; //handle -> slot, bucket absent if not in the heap
+
+    // The bucket for key.
+    int bucketOf(std::uint32_t key) const {
+        return key == lastKey ? 0 : 32 - __builtin_clz(key ^ lastKey);
+    }
+
+    // Append e to its bucket and record its slot.
+    void place(const entry_t &e);
+
+    // Take the entry at slot s out of its bucket and return it.
+    entry_t take(slot_t s);
+
+    public:
+        // The constructor makes room for handles 0 to capacity - 1;
+        // larger handles (below 2^32) make the heap grow.
+        radixHeap(std::size_t capacity = 0);
+
+        // Insert the specified handle with the specified key.
+        // Returns 0 on success,
+        // 1 if the handle is 2^32 or more, the key is below the last
+        //   one removed, or memory runs out,
+        // 2 if the handle is already in the heap.
+        int insert(std::size_t handle, int key);
+
+        // Change the key of the specified handle.
+        // Returns 0 on success,
+        // 1 if the handle is not in the heap, the key is below the
+        //   last one removed, or memory runs out.
+        int setKey(std::size_t handle, int key);
+
+        // Remove the handle with the smallest key, and provide its
+        // handle and key if the pointers are not nullptr.
+        // Returns 0 on success,
+        // 1 if the heap is empty.
+        int deleteMin(std::size_t *handle = nullptr, int *key = nullptr);
+
+        // Remove the specified handle, and provide its key if the
+        // pointer is not nullptr.
+        // Returns 0 on success,
+        // 1 if the handle is not in the heap.
+        int remove(std::size_t handle, int *key = nullptr);
+
+        // Remove every handle, and take the last key removed to be
+        // 0 again, so the heap can be used for another run.
+        void clear();
+
+        // Check if the specified handle is in the heap.
+        bool contains(std::size_t handle) const {
+            return handle < where.size() && where[handle].bucket != absent;
+        }
+
+        // Number of handles in the heap.
+        std::size_t size() const { return use; }
+};
+
+// A bucket queue (Dial's): a min-heap of integer handles with
+// non-negative int keys, for when keys are removed in nondecreasing
+// order and every key in the queue is within maxSpan of the last one
+// removed, as in Dijkstra's algorithm with edge costs of at most
+// maxSpan. It has the same interface as indexHeap.
+//
+// There is one bucket per key value in a window of maxSpan + 1 keys,
+// used circularly; deleteMin walks forward from the last key removed
+// to the next nonempty bucket. Every operation is O(1) but that walk,
+// which costs O(maxSpan) at most and O(n * maxSpan) over a whole run,
+// so it suits small spans.
+class bucketQueue {
+
+    // Where a handle's entry is: its key and index in the bucket.
+    typedef struct slot_s {
+        std::uint32_t key;
+        std::uint32_t index;
+    } slot_t;
+
+    static constexpr std::uint32_t absent = UINT32_MAX;
+
+    std::size_t use; //number of handles in the heap
+    std::uint32_t lastKey; //key last removed by deleteMin
+    std::vector<std::vector<std::uint32_t>> buckets; //key % buckets.size() -> handles
+    std::vector<slot_t> where; //handle -> slot, index absent if not in the heap
+
+    // Whether key falls in the window after the last key removed.
+    bool inWindow(int key) const {
+        return key >= 0 && static_cast<std::uint32_t>(key) >= lastKey &&
+               static_cast<std::uint32_t>(key) - lastKey < buckets.size();
+    }
+
+    // Append handle to the bucket for key and record its slot.
+    void place(std::uint32_t handle, std::uint32_t key);
+
+    // Take handle out of its bucket.
+    void take(std::uint32_t handle);
+
+    public:
+        // The constructor takes the largest gap allowed between the
+        // last key removed and any key in the queue, and makes room
+        // for handles 0 to capacity - 1; larger handles (below 2^32)
+        // make the queue grow.
+        bucketQueue(int maxSpan, std::size_t capacity = 0);
+
+        // Insert the specified handle with the specified key.
+        // Returns 0 on success,
+        // 1 if the handle is 2^32 or more, the key is outside the
+        //   window, or memory runs out,
+        // 2 if the handle is already in the heap.
+        int insert(std::size_t handle, int key);
+
+        // Change the key of the specified handle.
+        // Returns 0 on success,
+        // 1 if the handle is not in the heap, the key is outside
+        //   the window, or memory runs out.
+        int setKey(std::size_t handle, int key);
+
+        // Remove the handle with the smallest key, and provide its
+        // handle and key if the pointers are not nullptr.
+        // Returns 0 on success,
+        // 1 if the heap is empty.
+        int deleteMin(std::size_t *handle = nullptr, int *key = nullptr);
+
+        // Remove the specified handle, and provide its key if the
+        // pointer is not nullptr.
+        // Returns 0 on success,
+        // 1 if the handle is not in the heap.
+        int remove(std::size_t handle, int *key = nullptr);
+
+        // Remove every handle, and take the last key removed to be
+        // 0 again, so the heap can be used for another run.
+        void clear();
+
+        // Check if the specified handle is in the heap.
+        bool contains(std::size_t handle) const {
+            return handle < where.size() && where[handle].index != absent;
+        }
+
+        // Number of handles in the heap.
+        std::size_t size() const { return use; }
+};
+
+// An id with its key and pointer, for dheap's insertAll and setKeys.
+// The id is only read during the call.
+class heapItem {
+    public:
+        std::string_view id;
         int key;
         void *val;
-    } node_t;
+};
+
+// A min-heap of string ids, each with an int key and a pointer;
+// a front end to indexHeap<D> (D = 2, 4 or 8).
+//
+// Each id in the heap is given a handle, which is reused once the
+// id leaves. The id, its pointer and the id -> handle map are only
+// touched when an item comes in, goes out, or is looked up by id;
+// reordering the heap moves handles only.
+template <int D>
+class dheap {
+
+    int flags; //options passed to the constructor
 
-    static inline const void  *stringkey(const std::string &key);
-    static inline std::size_t  stringsiz(const std::string &key);
+    hashMap<std::string, std::size_t> *map; //id -> handle
+    std::vector<std::string> ids; //handle -> id
+    std::vector<void *> vals; //handle -> pointer
+    std::vector<std::size_t> freeHandles; //handles not in use
+    indexHeap<D> order; //handles ordered by key
 
-    void percolate_down(std::size_t pos);
-    void percolate_up(std::size_t pos);
+    // Take a free handle, or a new one past the last.
+    std::size_t acquire();
 
-    std::size_t siz; //capacity
-    std::size_t use; //number of slots currently used
-    hashTable *map; //hashtable
-    std::vector<node_t> nodes; //actual binary heap
+    // Forget the id and pointer of a handle that has left the heap,
+    // and make the handle free for reuse.
+    void release(std::size_t handle);
 
     public:
-        heap(std::size_t siz = 1);
-        ~heap(void);
+        // Options for the constructor's flags argument.
+        // GROWABLE - grow past the initial capacity instead of
+        //            failing inserts once it is reached, so the
+        //            capacity is only a hint.
+        enum { GROWABLE = 1 };
+
+        dheap(std::size_t siz = 1, int flags = 0);
+        ~dheap(void);
+
+        dheap(const dheap &) = delete;
+        dheap &operator=(const dheap &) = delete;
 
         int deleteMin(
             std::string  *id  = nullptr,
@@ -37,5 +439,22 @@ class heap {
             int *key = nullptr,
             void **val = nullptr
         );
+
+        // Insert count items at once; see indexHeap::insertAll.
+        // Returns 0 on success,
+        // 1 if there is no room for all of them (nothing is inserted),
+        // 2 if some ids were already in the heap or repeated
+        //   (those are skipped; the rest are inserted).
+        int insertAll(const heapItem *items, std::size_t count);
+
+        // Change the keys of count ids at once; the pointers in
+        // items are ignored. See indexHeap::setKeys.
+        // Returns 0 on success,
+        // 1 if some ids were not in the heap (those are skipped).
+        int setKeys(const heapItem *items, std::size_t count);
 };
 
+// The binary heap, under its original name.
+typedef dheap<2> heap;
+
+#endif //_HEAP_H
@@ -0,0 +1,62 @@
+#include <algorithm>
+#include <functional>
+#include <random>
+#include <thread>
+#include "multiqueue.h"
+
+multiQueue::multiQueue(std::size_t queues)
+    : queueCount(queues > 0 ? queues : 1), queues(new subQueue[queueCount])
+{
+}
+
+std::size_t multiQueue::pick() const
+{
+    thread_local std::minstd_rand rng(std::hash<std::thread::id>()(std::this_thread::get_id()));
+    return rng() % queueCount;
+}
+
+int multiQueue::insert(std::size_t handle, int key)
+{
+    subQueue &q = queues[pick()];
+    std::lock_guard<std::mutex> guard(q.lock);
+    if (q.heap.insert(handle, key) != 0) return 1;
+    refresh(q);
+    use.fetch_add(1, std::memory_order_relaxed);
+    return 0;
+}
+
+int multiQueue::deleteMin(std::size_t *handle, int *key)
+{
+    // Sample two sub-queues a few times; a sub-queue may be emptied
+    // between reading its smallest key and taking its lock
+    for (int tries = 0; tries < 4; ++tries) {
+        subQueue &a = queues[pick()];
+        subQueue &b = queues[pick()];
+        int topA = a.top.load(std::memory_order_relaxed);
+        int topB = b.top.load(std::memory_order_relaxed);
+        subQueue &q = (topB < topA) ? b : a;
+        if (std::min(topA, topB) == INT_MAX) continue;
+
+        std::unique_lock<std::mutex> guard(q.lock, std::try_to_lock);
+        if (!guard.owns_lock() || q.heap.size() == 0) continue;
+        q.heap.deleteMin(handle, key);
+        refresh(q);
+        use.fetch_sub(1, std::memory_order_relaxed);
+        return 0;
+    }
+
+    // Few entries left: look at every sub-queue before giving up,
+    // skipping those that look empty or that another thread holds,
+    // so idle threads do not queue up behind the ones at work
+    for (std::size_t i = 0; i < queueCount; ++i) {
+        subQueue &q = queues[i];
+        if (q.top.load(std::memory_order_relaxed) == INT_MAX) continue;
+        std::unique_lock<std::mutex> guard(q.lock, std::try_to_lock);
+        if (!guard.owns_lock() || q.heap.size() == 0) continue;
+        q.heap.deleteMin(handle, key);
+        refresh(q);
+        use.fetch_sub(1, std::memory_order_relaxed);
+        return 0;
+    }
+    return 1;
+}
@@ -0,0 +1,77 @@
+#ifndef _MULTIQUEUE_H
+#define _MULTIQUEUE_H
+
+#include <atomic>
+#include <climits>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include "heap.h"
+
+// A relaxed min-heap of integer handles with int keys that many
+// threads may use at once (a MultiQueue).
+//
+// It is a fixed set of lazyHeap<4> sub-queues, each with its own lock.
+// insert puts an entry in a random sub-queue; deleteMin looks at the
+// smallest keys of two random sub-queues and takes from the smaller.
+// Threads therefore rarely wait for one another, at the price of
+// order: deleteMin returns a small key, usually among the smallest
+// few, not always the smallest. Algorithms that use it must tolerate
+// that, as label-correcting shortest paths do.
+//
+// As with lazyHeap, a handle may be in it any number of times; to
+// decrease a key, insert the handle again and skip the stale copies.
+class multiQueue {
+
+    // One sub-queue and a copy of its smallest key (INT_MAX when
+    // empty) that deleteMin can compare without taking the lock.
+    // Sub-queues are kept on separate cache lines so threads using
+    // neighbouring ones do not slow each other down.
+    class alignas(64) subQueue {
+        public:
+            std::mutex lock;
+            std::atomic<int> top {INT_MAX};
+            lazyHeap<4> heap;
+    };
+
+    std::size_t queueCount;
+    std::unique_ptr<subQueue[]> queues;
+    std::atomic<std::size_t> use {0}; //entries in all sub-queues
+
+    // A random sub-queue, from a generator private to the thread.
+    std::size_t pick() const;
+
+    // Refresh the copy of q's smallest key; called with q's lock held.
+    static void refresh(subQueue &q) {
+        q.top.store(q.heap.size() ? q.heap.minKey() : INT_MAX, std::memory_order_relaxed);
+    }
+
+    public:
+        // The constructor makes the specified number of sub-queues;
+        // two or more per thread that will use it works well.
+        multiQueue(std::size_t queues);
+
+        multiQueue(const multiQueue &) = delete;
+        multiQueue &operator=(const multiQueue &) = delete;
+
+        // Insert the specified handle with the specified key, whether
+        // or not it is in the queue already.
+        // Returns 0 on success,
+        // 1 if the handle is 2^32 or more, or memory runs out.
+        int insert(std::size_t handle, int key);
+
+        // Remove an entry with a small key, and provide its handle and
+        // key if the pointers are not nullptr.
+        // Never waits for a lock another thread holds.
+        // Returns 0 on success,
+        // 1 if no entry was found: every sub-queue looked empty or was
+        //   in use by another thread, so entries may remain; callers
+        //   that need them all should check size() and try again.
+        int deleteMin(std::size_t *handle = nullptr, int *key = nullptr);
+
+        // Number of entries in the queue, stale copies included.
+        // Exact only when no insert or deleteMin is running.
+        std::size_t size() const { return use.load(std::memory_order_relaxed); }
+};
+
+#endif //_MULTIQUEUE_H
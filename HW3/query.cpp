@@ -0,0 +1,91 @@
+#include <algorithm>
+#include "query.h"
+#include "search.h"
+
+queryEngine::queryEngine(const Graph &graph, unsigned threads)
+    : graph(graph), useBuckets(graph.getMaxCost() <= bucketMaxCost),
+      starts(nullptr), count(0), next(0), remaining(0), failed(false), searching(0),
+      done(nullptr), stopping(false)
+{
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (unsigned t = 0; t < threads; t++) {
+        workers.emplace_back(&queryEngine::work, this);
+    }
+}
+
+queryEngine::~queryEngine()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+}
+
+int queryEngine::run(const std::uint32_t *starts, std::size_t count, const resultFunction &done)
+{
+    std::unique_lock<std::mutex> guard(lock);
+    this->starts = starts;
+    this->count = count;
+    this->done = &done;
+    next = 0;
+    remaining = count;
+    failed = false;
+    searching = 0;
+    wake.notify_all();
+    finished.wait(guard, [this] { return remaining == 0; });
+    this->starts = nullptr;
+    this->count = 0;
+    this->done = nullptr;
+    return failed ? 1 : 0;
+}
+
+void queryEngine::work()
+{
+    if (useBuckets) {
+        bucketQueue pq(graph.getMaxCost());
+        serve(pq);
+    } else {
+        indexHeap<4> pq;
+        serve(pq);
+    }
+}
+
+template <typename Queue>
+void queryEngine::serve(Queue &pq)
+{
+    searchState state;
+    std::unique_lock<std::mutex> guard(lock);
+    while (true) {
+        wake.wait(guard, [this] { return stopping || next < count; });
+        if (stopping) {
+            return;
+        }
+
+        // Search without the lock, so the workers run side by side
+        std::size_t i = next++;
+        std::uint32_t start = starts[i];
+        const resultFunction &report = *done;
+        guard.unlock();
+        auto searchStart = std::chrono::steady_clock::now();
+        int status = shortestPaths(graph, start, pq, state);
+        restart(pq);
+        auto searchEnd = std::chrono::steady_clock::now();
+        report(i, state);
+        guard.lock();
+
+        searching += std::chrono::duration<double>(searchEnd - searchStart).count();
+        if (status != 0) {
+            failed = true;
+        }
+
+        if (--remaining == 0) {
+            finished.notify_all();
+        }
+    }
+}
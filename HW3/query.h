@@ -0,0 +1,87 @@
+#ifndef _QUERY_H
+#define _QUERY_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "graph.h"
+
+// Runs many shortest path searches on one graph at once, from a pool
+// of worker threads.
+//
+// The graph is only read: each worker keeps its own queue and its own
+// searchState, which it reuses from one search to the next, so a
+// search costs in proportion to the part of the graph it reaches and
+// nothing in the graph is written. Each worker picks the queue the
+// driver would: a bucket queue when no edge costs more than
+// bucketMaxCost (see search.h), and the 4-ary heap otherwise.
+class queryEngine {
+
+    public:
+        // Signature of the function run calls with each result: the
+        // position of the start vertex in the batch, and its search.
+        typedef std::function<void(std::size_t, const searchState &)> resultFunction;
+
+        // The constructor starts the specified number of workers
+        // (0 for one per core) on graph, which must stay loaded and
+        // unchanged while the engine exists.
+        queryEngine(const Graph &graph, unsigned threads = 0);
+        ~queryEngine();
+
+        queryEngine(const queryEngine &) = delete;
+        queryEngine &operator=(const queryEngine &) = delete;
+
+        // Search from each of count start vertices (by index; noVertex
+        // gives a search that reaches nothing), spread over the
+        // workers. done(i, state) is called on a worker thread as soon
+        // as the search from starts[i] is over, possibly on several
+        // workers at once; state is only valid during the call.
+        // Returns once every call has returned. Only one run may be
+        // in progress at a time.
+        // Returns 0 on success,
+        // 1 if a worker's queue ran out of memory; the searches it
+        //   could not finish are reported with what they reached.
+        int run(const std::uint32_t *starts, std::size_t count, const resultFunction &done);
+
+        // Number of worker threads.
+        unsigned threadCount() const { return workers.size(); }
+
+        // Seconds the workers spent searching in the last run, added
+        // up over the workers; the calls to done are not counted.
+        double searchTime() const { return searching; }
+
+    private:
+        const Graph &graph;
+        bool useBuckets;
+        std::vector<std::thread> workers;
+
+        // The batch being run, guarded by lock. Workers wait on
+        // wake for a start to take; run waits on finished for the
+        // last search to be over.
+        std::mutex lock;
+        std::condition_variable wake;
+        std::condition_variable finished;
+        const std::uint32_t *starts;
+        std::size_t count;
+        std::size_t next; //next start to hand out
+        std::size_t remaining; //searches not yet over
+        bool failed; //a search of the batch could not finish
+        double searching; //seconds spent in searches of the batch
+        const resultFunction *done;
+        bool stopping;
+
+        // A worker's loop: take starts and search from them until the
+        // engine is destroyed.
+        void work();
+
+        // The same, with the worker's queue.
+        template <typename Queue>
+        void serve(Queue &pq);
+};
+
+#endif //_QUERY_H
@@ -0,0 +1,119 @@
+#ifndef _SEARCH_H
+#define _SEARCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include "graph.h"
+#include "heap.h"
+
+// Largest edge cost for which a bucket queue is picked on its own;
+// its deleteMin walks up to this many empty buckets.
+const int bucketMaxCost = 1000;
+
+// Largest edge cost for which a bucket queue is built at all, even
+// when asked for; it holds one bucket per key up to the largest cost.
+const int bucketLimit = 1 << 20;
+
+// Give vertex index the smaller distance dist in the queue.
+// Returns 0 on success, 1 if the queue has no room for it.
+template <typename Queue>
+int decreaseKey(Queue &pq, std::size_t index, int dist) {
+    if (pq.contains(index)) {
+        return pq.setKey(index, dist);
+    }
+    return pq.insert(index, dist);
+}
+
+// The lazy heap takes another copy of the vertex instead; the old
+// one comes out after it, when the vertex is already known.
+inline int decreaseKey(lazyHeap<4> &pq, std::size_t index, int dist) {
+    return pq.insert(index, dist);
+}
+
+// Make a queue that shortestPaths has emptied ready for another
+// search; only the monotone queues need it, to forget the last key.
+template <typename Queue>
+void restart(Queue &) {
+}
+
+inline void restart(bucketQueue &pq) {
+    pq.clear();
+}
+
+inline void restart(radixHeap &pq) {
+    pq.clear();
+}
+
+// Dijkstra's algorithm from vertex start, leaving the results in state,
+// which is reset first. Only the graph's edge arrays are read, so any
+// number of searches may run on one graph at once, each with its own
+// queue and state.
+//
+// Queue is an empty indexHeap<4>, lazyHeap<4>, radixHeap or
+// bucketQueue, and is empty again afterwards; vertices leave it in
+// nondecreasing order of distance, which the last two rely on, and no
+// distance in it exceeds the last one removed by more than the largest
+// edge cost, which bounds the bucket queue's window.
+//
+// Returns 0 on success,
+// 1 if the queue had no room for a vertex (memory ran out); the
+//   search stops there and state only holds what it reached.
+template <typename Queue>
+int shortestPaths(const Graph &graph, std::uint32_t start, Queue &pq, searchState &state) {
+    state.reset(graph.vertexCount());
+    if (start == Graph::noVertex) {
+        return 0;
+    }
+
+    // The search runs on vertex indices and the edge arrays alone;
+    // names only come back into it when the results are written.
+    // Vertices are inserted when first reached, so the queue only
+    // ever holds the frontier and unreachable vertices never enter it.
+    const std::uint64_t *offsets = graph.edgeOffsets();
+    const std::uint32_t *targets = graph.edgeTargets();
+    const int *weights = graph.edgeWeights();
+    int *dist = state.dist.data();
+    char *known = state.known.data();
+
+    state.reach(start, 0, Graph::noVertex);
+    if (pq.insert(start, 0) != 0) {
+        return 1;
+    }
+
+    // Main Dijkstra's algorithm loop
+    while (true) {
+        std::size_t v;
+
+        if (pq.deleteMin(&v) != 0) {
+            break;
+        }
+
+        if (known[v]) {
+            continue;
+        }
+
+        known[v] = true;
+
+        // Update distances to adjacent nodes
+        for (std::size_t e = offsets[v]; e < offsets[v + 1]; e++) {
+            std::uint32_t w = targets[e];
+
+            if (!known[w]) {
+                int newDist = dist[v] + weights[e];
+
+                if (newDist < dist[w]) {
+                    state.reach(w, newDist, v);
+                    if (decreaseKey(pq, w, newDist) != 0) {
+                        // Leave the queue empty, as on success
+                        while (pq.deleteMin(&v) == 0) {
+                        }
+                        return 1;
+                    }
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+#endif //_SEARCH_H
@@ -0,0 +1,141 @@
+#ifndef _SWISSTABLE_H
+#define _SWISSTABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <string_view>
+
+// An alternative to hashTable with the same interface.
+// Every slot has a one-byte control value kept in its own dense
+// array; full slots store the low 7 bits of the key's hash there.
+// Lookups compare 16 control bytes at a time (SSE2 when available)
+// and only touch the key of a slot whose tag matches.
+class swissTable {
+
+ public:
+
+  // The constructor initializes the hash table.
+  // The capacity is a power of two (at least 16) large enough to
+  // hold the specified number of keys below the maximum load.
+  swissTable(int size = 0);
+
+  // Insert the specified key into the hash table.
+  // If an optional pointer is provided,
+  // associate that pointer with the key.
+  // Returns 0 on success,
+  // 1 if key already exists in hash table,
+  // 2 if rehash fails.
+  int insert(std::string_view key, void *pv = nullptr);
+
+  // Check if the specified key is in the hash table.
+  // If so, return true; otherwise, return false.
+  bool contains(std::string_view key) const;
+
+  // Get the pointer associated with the specified key.
+  // If the key does not exist in the hash table, return nullptr.
+  // If an optional pointer to a bool is provided,
+  // set the bool to true if the key is in the hash table,
+  // and set the bool to false otherwise.
+  void *getPointer(std::string_view key, bool *b = nullptr) const;
+
+  // Set the pointer associated with the specified key.
+  // Returns 0 on success,
+  // 1 if the key does not exist in the hash table.
+  int setPointer(std::string_view key, void *pv);
+
+  // Delete the item with the specified key.
+  // Returns true on success,
+  // false if the specified key is not in the hash table.
+  bool remove(std::string_view key);
+
+  // Look up count keys at once. found[i] (or pointers[i]) is set as
+  // contains (or getPointer) would for keys[i]. All hashes of a group
+  // are computed and their slots prefetched before any is probed,
+  // so the cache misses of independent lookups overlap.
+  void containsBatch(const std::string_view *keys, std::size_t count, bool *found) const;
+  void getPointerBatch(const std::string_view *keys, std::size_t count, void **pointers) const;
+
+  // The same operations on a key given as a pointer and length,
+  // e.g. a word inside a line buffer; nothing is allocated unless
+  // the key is actually inserted.
+  int insert(const char *key, std::size_t len, void *pv = nullptr)
+    { return insert(std::string_view(key, len), pv); }
+  bool contains(const char *key, std::size_t len) const
+    { return contains(std::string_view(key, len)); }
+  void *getPointer(const char *key, std::size_t len, bool *b = nullptr) const
+    { return getPointer(std::string_view(key, len), b); }
+  int setPointer(const char *key, std::size_t len, void *pv)
+    { return setPointer(std::string_view(key, len), pv); }
+  bool remove(const char *key, std::size_t len)
+    { return remove(std::string_view(key, len)); }
+
+ private:
+
+  // Number of control bytes scanned per probe step.
+  static constexpr std::size_t groupWidth = 16;
+
+  // Control byte values. Full slots hold a 7-bit tag (0..127),
+  // so empty and deleted both have the high bit set.
+  static constexpr std::int8_t ctrlEmpty = -128;
+  static constexpr std::int8_t ctrlDeleted = -2;
+
+  // Each slot holds the key and its associated pointer;
+  // whether the slot is in use is recorded only in ctrl.
+  class slot {
+  public:
+    std::string key {""};
+    void *pv {nullptr};
+
+    slot() = default;
+  };
+
+  std::size_t capacity; // Number of slots; always a power of two.
+  std::size_t filled; // Number of live items in the table.
+  std::size_t deleted; // Number of deleted (tombstone) slots.
+
+  // One control byte per slot, followed by a copy of the first
+  // groupWidth bytes so a group can be loaded from any position.
+  std::vector<std::int8_t> ctrl;
+  std::vector<slot> slots; // The actual entries are here.
+
+  // The hash function; h1 picks the starting slot, h2 is the tag.
+  static std::size_t hash(std::string_view key);
+  static std::size_t h1(std::size_t h) { return h >> 7; }
+  static std::int8_t h2(std::size_t h) { return h & 0x7f; }
+
+  // Bit i of the result is set if control byte pos + i
+  // equals the specified value (or has its high bit set).
+  std::uint32_t matchByte(std::size_t pos, std::int8_t value) const;
+  std::uint32_t matchEmpty(std::size_t pos) const;
+  std::uint32_t matchEmptyOrDeleted(std::size_t pos) const;
+
+  // Write a control byte, keeping the mirrored tail in sync.
+  void setCtrl(std::size_t pos, std::int8_t value);
+
+  // Search for an item with the specified key.
+  // Return the position if found, -1 otherwise.
+  long findPos(std::string_view key, std::size_t h) const;
+
+  // Number of lookups a batch call hashes and prefetches together.
+  static const int batchGroup = 16;
+
+  // Find the positions (or -1) of count keys, batchGroup at a time.
+  void findBatch(const std::string_view *keys, std::size_t count, long *positions) const;
+
+  // Return the first empty or deleted slot on the probe
+  // sequence for hash h.
+  std::size_t findFree(std::size_t h);
+
+  // Rebuild the table with the specified capacity,
+  // dropping tombstones along the way.
+  // Returns true on success, false if memory allocation fails.
+  bool rehash(std::size_t newCapacity);
+
+  // Return the smallest power of two capacity (at least
+  // groupWidth) that keeps size items below the maximum load.
+  static std::size_t getCapacity(std::size_t size);
+};
+
+#endif //_SWISSTABLE_H